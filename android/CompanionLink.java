@@ -0,0 +1,102 @@
+package com.picow.lennyface;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+// The companion side of the firmware's CDC protocol (companion.h), as
+// tools/lenny_companion speaks it: answer each ping frame with ACK seq|0x80,
+// decode each text frame, skip everything else on the port (the debug log).
+//
+// Frames are parsed a byte at a time, so it does not matter how the USB
+// transfers split them, and the text is decoded as it arrives. The listener
+// hears about each text once, when its frame is complete.
+//
+// Talks to the device only through Endpoint, so it runs on the JVM against
+// a fake one; UsbRequestEndpoint is the real thing.
+final class CompanionLink implements Runnable {
+
+    static final int STX = 0x02;
+    static final int ACK = 0x06;
+    static final int PING = 'P';
+    static final int TEXT = 'T';
+
+    static final int BAUD = 1000000;   // opening the port at this rate announces us
+    static final int MAX_TEXT = 4096;  // longer texts are skipped, like the daemon does
+
+    private static final int HEADER = 5;  // STX, type, seq, length
+
+    interface Endpoint {
+        // Blocks until the next IN transfer completes and returns its bytes
+        // (position to limit), or null once the endpoint is closed. The
+        // buffer is only valid until the next call.
+        ByteBuffer read() throws IOException;
+
+        void write(byte[] data) throws IOException;
+    }
+
+    interface Listener {
+        void onText(String text);
+
+        // The device went away or the endpoint was closed; run() returns
+        void onClosed();
+    }
+
+    private final Endpoint endpoint;
+    private final Listener listener;
+    private final Utf8Stream decoder = new Utf8Stream();
+
+    private final byte[] header = new byte[HEADER];
+    private int have;     // bytes of the current frame seen, 0 = outside a frame
+    private int length;   // payload length of the current frame
+
+    CompanionLink(Endpoint endpoint, Listener listener) {
+        this.endpoint = endpoint;
+        this.listener = listener;
+    }
+
+    @Override
+    public void run() {
+        try {
+            ByteBuffer data;
+            while ((data = endpoint.read()) != null) {
+                while (data.hasRemaining()) parse(data.get());
+            }
+        } catch (IOException e) {
+            // Unplugged mid-transfer - same as closed
+        }
+        listener.onClosed();
+    }
+
+    void parse(byte b) throws IOException {
+        if (have == 0) {
+            if (b == STX) header[have++] = b;
+            return;
+        }
+
+        if (have < HEADER) {
+            header[have++] = b;
+            if (have == HEADER) {
+                length = (header[3] & 0xFF) | (header[4] & 0xFF) << 8;
+                decoder.reset();
+                if (length == 0) frameDone();
+            }
+            return;
+        }
+
+        int at = have++ - HEADER;
+        if (header[1] == TEXT && length <= MAX_TEXT) decoder.feed(b);
+        if (at + 1 == length) frameDone();
+    }
+
+    private void frameDone() throws IOException {
+        int type = header[1];
+        int seq = header[2] & 0xFF;
+        have = 0;
+
+        if (type == PING) {
+            endpoint.write(new byte[] { ACK, (byte) (seq | 0x80) });
+        } else if (type == TEXT && length <= MAX_TEXT) {
+            listener.onText(decoder.finish());
+        }
+    }
+}
@@ -6,6 +6,7 @@ import android.content.BroadcastReceiver;
 import android.content.Context;
 import android.content.Intent;
 import android.content.IntentFilter;
+import android.hardware.usb.UsbConstants;
 import android.hardware.usb.UsbDevice;
 import android.hardware.usb.UsbDeviceConnection;
 import android.hardware.usb.UsbEndpoint;
@@ -16,20 +17,33 @@ import android.widget.TextView;
 import android.widget.Toast;
 import android.content.ClipboardManager;
 import android.content.ClipData;
-import java.nio.charset.StandardCharsets;
+import java.io.IOException;
 import java.util.HashMap;
 import java.util.Map;
+import java.util.concurrent.atomic.AtomicReference;
 
 public class MainActivity extends Activity {
 
     private static final String ACTION_USB_PERMISSION = "com.picow.lennyface.USB_PERMISSION";
 
+    // CDC ACM class requests, sent to the communication interface
+    private static final int CDC_SET_LINE_CODING = 0x20;
+    private static final int CDC_SET_CONTROL_LINE_STATE = 0x22;
+    private static final int CDC_DTR_RTS = 0x03;
+
     private UsbManager usbManager;
     private UsbDevice device;
     private UsbDeviceConnection connection;
     private UsbInterface cdcInterface;
+    private UsbInterface commInterface;   // CDC communication interface, takes the line coding
     private UsbEndpoint readEndpoint;
     private UsbEndpoint writeEndpoint;
+    private UsbRequestEndpoint endpoint;
+    private Thread reader;
+
+    // Newest text not yet on the clipboard - texts that arrive faster than
+    // the UI thread runs collapse into one update
+    private final AtomicReference<String> pendingText = new AtomicReference<>();
 
     private TextView statusText;
     private ClipboardManager clipboard;
@@ -93,10 +107,13 @@ public class MainActivity extends Activity {
         // Get list of attached devices
         HashMap<String, UsbDevice> deviceList = usbManager.getDeviceList();
 
-        // Look for our device (VID=0xCafe, PID=0x4001)
+        // Look for our device - an image with the CDC port: the debug image
+        // (VID=0xCafe, PID=0x4004) or lenny_keyboard built with
+        // LENNY_COMPANION (PID=0x4005)
         for (Map.Entry<String, UsbDevice> entry : deviceList.entrySet()) {
             UsbDevice dev = entry.getValue();
-            if (dev.getVendorId() == 0xCafe && dev.getProductId() == 0x4001) {
+            int pid = dev.getProductId();
+            if (dev.getVendorId() == 0xCafe && (pid == 0x4004 || pid == 0x4005)) {
                 requestDevicePermission(dev);
                 return;
             }
@@ -153,7 +170,21 @@ public class MainActivity extends Activity {
             return;
         }
 
+        // The communication interface takes the line coding
+        UsbInterface commInterface = null;
+        for (int i = 0; i < device.getInterfaceCount(); i++) {
+            if (device.getInterface(i).getInterfaceClass() == UsbConstants.USB_CLASS_COMM) {
+                commInterface = device.getInterface(i);
+                break;
+            }
+        }
+        if (commInterface == null) {
+            statusText.setText("CDC interface not found");
+            return;
+        }
+
         this.cdcInterface = cdcInterface;
+        this.commInterface = commInterface;
         this.readEndpoint = readEndpoint;
         this.writeEndpoint = writeEndpoint;
 
@@ -164,8 +195,13 @@ public class MainActivity extends Activity {
             return;
         }
 
-        // Claim interface
-        if (connection.claimInterface(cdcInterface, true)) {
+        // Claim both interfaces - class requests go to the communication one
+        if (connection.claimInterface(cdcInterface, true) && connection.claimInterface(commInterface, true)) {
+            if (!openPort(commInterface.getId())) {
+                statusText.setText("Failed to open the serial port");
+                closeDevice();
+                return;
+            }
             statusText.setText("Connected to Pico W\n\nShort GP4 and GP5\nto send lenny face");
             startReading();
         } else {
@@ -174,45 +210,89 @@ public class MainActivity extends Activity {
         }
     }
 
+    // Open the port the way lenny_companion does: COMPANION_BAUD tells the
+    // firmware a companion is listening, DTR makes the port connected
+    private boolean openPort(int commInterface) {
+        int baud = CompanionLink.BAUD;
+        byte[] coding = { (byte) baud, (byte) (baud >> 8), (byte) (baud >> 16), (byte) (baud >> 24),
+                          0, 0, 8 };  // 1 stop bit, no parity, 8 data bits
+        int out = UsbConstants.USB_DIR_OUT | UsbConstants.USB_TYPE_CLASS | 0x01;  // to the interface
+        return connection.controlTransfer(out, CDC_SET_LINE_CODING, 0, commInterface,
+                                          coding, coding.length, 100) == coding.length
+            && connection.controlTransfer(out, CDC_SET_CONTROL_LINE_STATE, CDC_DTR_RTS, commInterface,
+                                          null, 0, 100) == 0;
+    }
+
     private void startReading() {
-        new Thread(new Runnable() {
+        final UsbRequestEndpoint endpoint;
+        try {
+            endpoint = new UsbRequestEndpoint(connection, readEndpoint, writeEndpoint);
+        } catch (IOException e) {
+            statusText.setText("Failed to start reading: " + e.getMessage());
+            return;
+        }
+        this.endpoint = endpoint;
+
+        reader = new Thread(new CompanionLink(endpoint, new CompanionLink.Listener() {
+            @Override
+            public void onText(String text) {
+                if (pendingText.getAndSet(text) == null) runOnUiThread(showText);
+            }
+
             @Override
-            public void run() {
-                byte[] buffer = new byte[256];
-                while (connection != null && readEndpoint != null) {
-                    int bytesRead = connection.bulkTransfer(readEndpoint, buffer, buffer.length, 100);
-
-                    if (bytesRead > 0) {
-                        final String data = new String(buffer, 0, bytesRead, StandardCharsets.UTF_8);
-                        handleReceivedData(data);
+            public void onClosed() {
+                runOnUiThread(new Runnable() {
+                    @Override
+                    public void run() {
+                        // Unplugged, rather than closed by closeDevice()
+                        if (MainActivity.this.endpoint != endpoint) return;
+                        closeDevice();
+                        statusText.setText("Pico W disconnected");
                     }
-                }
+                });
             }
-        }).start();
+        }), "companion");
+        reader.start();
     }
 
-    private void handleReceivedData(final String data) {
-        runOnUiThread(new Runnable() {
-            @Override
-            public void run() {
-                // Copy received text to clipboard
-                ClipData clip = ClipData.newPlainText("Lenny Face", data);
-                clipboard.setPrimaryClip(clip);
+    private final Runnable showText = new Runnable() {
+        @Override
+        public void run() {
+            String text = pendingText.getAndSet(null);
+            if (text == null) return;
 
-                statusText.setText("Copied to clipboard:\n" + data + "\n\nPaste with Ctrl+V or long-press");
+            // Copy received text to clipboard
+            ClipData clip = ClipData.newPlainText("Lenny Face", text);
+            clipboard.setPrimaryClip(clip);
 
-                Toast.makeText(MainActivity.this, "Copied: " + data, Toast.LENGTH_SHORT).show();
-            }
-        });
-    }
+            statusText.setText("Copied to clipboard:\n" + text + "\n\nPaste with Ctrl+V or long-press");
+
+            Toast.makeText(MainActivity.this, "Copied: " + text, Toast.LENGTH_SHORT).show();
+        }
+    };
 
     private void closeDevice() {
-        if (connection != null && cdcInterface != null) {
-            connection.releaseInterface(cdcInterface);
+        // Wake the reader and let it free its requests before the
+        // connection goes
+        if (endpoint != null) {
+            endpoint.close();
+            try {
+                reader.join(500);
+            } catch (InterruptedException e) {
+                Thread.currentThread().interrupt();
+            }
+        }
+        endpoint = null;
+        reader = null;
+
+        if (connection != null) {
+            if (commInterface != null) connection.releaseInterface(commInterface);
+            if (cdcInterface != null) connection.releaseInterface(cdcInterface);
             connection.close();
         }
         connection = null;
         cdcInterface = null;
+        commInterface = null;
         readEndpoint = null;
         writeEndpoint = null;
     }
@@ -0,0 +1,99 @@
+package com.picow.lennyface;
+
+import android.hardware.usb.UsbDeviceConnection;
+import android.hardware.usb.UsbEndpoint;
+import android.hardware.usb.UsbRequest;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+// CompanionLink.Endpoint over the CDC data interface's bulk endpoints.
+//
+// READ_REQUESTS IN transfers are kept queued with the host controller at
+// all times, so the device never waits for the app to ask for the next
+// packet, and the reader thread sleeps in requestWait() instead of polling
+// with a timeout. A completed request is handed out by read() and queued
+// again on the next call, once its bytes have been parsed.
+//
+// Needs API 26: before that a completed request does not say how many bytes
+// it received.
+final class UsbRequestEndpoint implements CompanionLink.Endpoint {
+
+    private static final int READ_REQUESTS = 4;
+    private static final int WRITE_TIMEOUT_MS = 20;  // well inside the firmware's 50 ms
+
+    private final UsbDeviceConnection connection;
+    private final UsbEndpoint out;
+    private final UsbRequest[] requests = new UsbRequest[READ_REQUESTS];
+    private UsbRequest current;   // handed out by the last read()
+    private int queued;           // requests with the host controller
+    private volatile boolean closed;
+
+    UsbRequestEndpoint(UsbDeviceConnection connection, UsbEndpoint in, UsbEndpoint out) throws IOException {
+        this.connection = connection;
+        this.out = out;
+
+        for (int i = 0; i < READ_REQUESTS; i++) {
+            UsbRequest r = new UsbRequest();
+            if (!r.initialize(connection, in)) throw new IOException("UsbRequest.initialize failed");
+            r.setClientData(ByteBuffer.allocate(in.getMaxPacketSize()));
+            requests[i] = r;
+        }
+        for (UsbRequest r : requests) queue(r);
+    }
+
+    @Override
+    public ByteBuffer read() throws IOException {
+        if (current != null) {
+            queue(current);
+            current = null;
+        }
+
+        while (!closed) {
+            // null once the device is gone
+            UsbRequest r = connection.requestWait();
+            if (r == null) break;
+            queued--;
+            if (closed) break;
+
+            // A completed IN transfer leaves the position at the byte count
+            ByteBuffer data = (ByteBuffer) r.getClientData();
+            if (data.position() == 0) {
+                queue(r);   // zero-length packet
+                continue;
+            }
+            data.flip();
+            current = r;
+            return data;
+        }
+
+        // A cancelled request still completes; it may only be closed once
+        // requestWait() has handed it back
+        while (queued > 0 && connection.requestWait() != null) queued--;
+        for (UsbRequest r : requests) r.close();
+        return null;
+    }
+
+    @Override
+    public void write(byte[] data) throws IOException {
+        if (connection.bulkTransfer(out, data, data.length, WRITE_TIMEOUT_MS) != data.length) {
+            throw new IOException("bulkTransfer failed");
+        }
+    }
+
+    // From any thread. Cancelled requests complete, so a reader waiting in
+    // read() wakes up, collects the rest of them and returns null; it frees
+    // the requests itself.
+    void close() {
+        closed = true;
+        for (UsbRequest r : requests) r.cancel();
+    }
+
+    private void queue(UsbRequest r) throws IOException {
+        ByteBuffer data = (ByteBuffer) r.getClientData();
+        data.clear();
+        if (!r.queue(data)) throw new IOException("UsbRequest.queue failed");
+        queued++;
+        // close() may have cancelled the others just before
+        if (closed) r.cancel();
+    }
+}
@@ -0,0 +1,76 @@
+package com.picow.lennyface;
+
+// Streaming UTF-8 decoder - bytes go in one at a time, in as many pieces as
+// the USB transfers happened to split them into, and a sequence split
+// across two transfers still decodes as one character. Malformed input
+// (stray continuation bytes, overlong forms, surrogates, a sequence cut off
+// by finish()) becomes U+FFFD. No Android dependencies.
+final class Utf8Stream {
+
+    private static final char REPLACEMENT = '\uFFFD';
+
+    private final StringBuilder text = new StringBuilder();
+    private int codepoint;
+    private int need;   // continuation bytes still to come
+    private int min;    // smallest codepoint the current sequence may encode
+
+    void feed(byte b) {
+        int c = b & 0xFF;
+
+        if (need > 0) {
+            if ((c & 0xC0) == 0x80) {
+                codepoint = (codepoint << 6) | (c & 0x3F);
+                if (--need == 0) finishCodepoint();
+                return;
+            }
+            // Sequence cut short - this byte starts the next one
+            need = 0;
+            text.append(REPLACEMENT);
+        }
+
+        if (c < 0x80) {
+            text.append((char) c);
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            start(c & 0x1F, 1, 0x80);
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            start(c & 0x0F, 2, 0x800);
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            start(c & 0x07, 3, 0x10000);
+        } else {
+            text.append(REPLACEMENT);
+        }
+    }
+
+    void feed(byte[] bytes, int offset, int length) {
+        for (int i = 0; i < length; i++) feed(bytes[offset + i]);
+    }
+
+    // Everything decoded so far; an unfinished sequence counts as malformed.
+    // The decoder is ready for the next message afterwards.
+    String finish() {
+        if (need > 0) text.append(REPLACEMENT);
+        String s = text.toString();
+        reset();
+        return s;
+    }
+
+    void reset() {
+        text.setLength(0);
+        need = 0;
+    }
+
+    private void start(int bits, int continuations, int smallest) {
+        codepoint = bits;
+        need = continuations;
+        min = smallest;
+    }
+
+    private void finishCodepoint() {
+        boolean surrogate = codepoint >= 0xD800 && codepoint <= 0xDFFF;
+        if (codepoint < min || surrogate || codepoint > 0x10FFFF) {
+            text.append(REPLACEMENT);
+        } else {
+            text.appendCodePoint(codepoint);
+        }
+    }
+}
@@ -0,0 +1,148 @@
+package com.picow.lennyface;
+
+import static org.junit.Assert.assertArrayEquals;
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+
+import java.io.ByteArrayOutputStream;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import org.junit.Test;
+
+// CompanionLink against a fake endpoint: the device side of companion.h,
+// with the debug log around the frames and the transfers split anywhere
+public class CompanionLinkTest {
+
+    private static final String LENNY = "( \u0361\u00B0 \u035C\u0296 \u0361\u00B0 )";
+
+    // Hands out the given transfers, then reports the endpoint closed
+    private static final class FakeEndpoint implements CompanionLink.Endpoint {
+        final ArrayDeque<byte[]> transfers = new ArrayDeque<>();
+        final ByteArrayOutputStream written = new ByteArrayOutputStream();
+
+        @Override
+        public ByteBuffer read() {
+            byte[] next = transfers.poll();
+            return next == null ? null : ByteBuffer.wrap(next);
+        }
+
+        @Override
+        public void write(byte[] data) {
+            written.write(data, 0, data.length);
+        }
+    }
+
+    private static final class Recorder implements CompanionLink.Listener {
+        final List<String> texts = new ArrayList<>();
+        boolean closed;
+
+        @Override
+        public void onText(String text) {
+            texts.add(text);
+        }
+
+        @Override
+        public void onClosed() {
+            closed = true;
+        }
+    }
+
+    private static byte[] frame(int type, int seq, byte[] payload) {
+        ByteArrayOutputStream f = new ByteArrayOutputStream();
+        f.write(CompanionLink.STX);
+        f.write(type);
+        f.write(seq);
+        f.write(payload.length & 0xFF);
+        f.write(payload.length >> 8);
+        f.write(payload, 0, payload.length);
+        return f.toByteArray();
+    }
+
+    // A handshake and its text between log lines, as the firmware sends them
+    private static byte[] session(int seq, String text) {
+        ByteArrayOutputStream s = new ByteArrayOutputStream();
+        byte[] log = "[1080] -> TYPING\r\n".getBytes(StandardCharsets.US_ASCII);
+        byte[] ping = frame(CompanionLink.PING, seq, new byte[0]);
+        byte[] body = frame(CompanionLink.TEXT, seq, text.getBytes(StandardCharsets.UTF_8));
+        s.write(log, 0, log.length);
+        s.write(ping, 0, ping.length);
+        s.write(body, 0, body.length);
+        s.write(log, 0, log.length);
+        return s.toByteArray();
+    }
+
+    private static Recorder run(FakeEndpoint endpoint) {
+        Recorder recorder = new Recorder();
+        new CompanionLink(endpoint, recorder).run();
+        assertTrue(recorder.closed);
+        return recorder;
+    }
+
+    @Test
+    public void answersPingAndDeliversText() {
+        FakeEndpoint endpoint = new FakeEndpoint();
+        endpoint.transfers.add(session(5, LENNY));
+
+        Recorder recorder = run(endpoint);
+        assertArrayEquals(new byte[] { CompanionLink.ACK, (byte) 0x85 }, endpoint.written.toByteArray());
+        assertEquals(1, recorder.texts.size());
+        assertEquals(LENNY, recorder.texts.get(0));
+    }
+
+    @Test
+    public void transfersSplitAtEveryByte() {
+        byte[] bytes = session(5, LENNY);
+
+        for (int at = 0; at <= bytes.length; at++) {
+            FakeEndpoint endpoint = new FakeEndpoint();
+            endpoint.transfers.add(Arrays.copyOfRange(bytes, 0, at));
+            endpoint.transfers.add(Arrays.copyOfRange(bytes, at, bytes.length));
+
+            Recorder recorder = run(endpoint);
+            assertEquals("split at " + at, 1, recorder.texts.size());
+            assertEquals("split at " + at, LENNY, recorder.texts.get(0));
+            assertEquals("split at " + at, 2, endpoint.written.size());
+        }
+    }
+
+    @Test
+    public void oneByteTransfers() {
+        FakeEndpoint endpoint = new FakeEndpoint();
+        for (byte b : session(7, LENNY)) endpoint.transfers.add(new byte[] { b });
+
+        Recorder recorder = run(endpoint);
+        assertArrayEquals(new byte[] { CompanionLink.ACK, (byte) 0x87 }, endpoint.written.toByteArray());
+        assertEquals(1, recorder.texts.size());
+        assertEquals(LENNY, recorder.texts.get(0));
+    }
+
+    @Test
+    public void skipsTooLongTextAndKeepsGoing() {
+        byte[] big = new byte[CompanionLink.MAX_TEXT + 1];
+        Arrays.fill(big, (byte) 'x');
+        FakeEndpoint endpoint = new FakeEndpoint();
+        endpoint.transfers.add(frame(CompanionLink.TEXT, 1, big));
+        endpoint.transfers.add(session(2, "next"));
+
+        Recorder recorder = run(endpoint);
+        assertEquals(1, recorder.texts.size());
+        assertEquals("next", recorder.texts.get(0));
+    }
+
+    @Test
+    public void eachTextOnce() {
+        FakeEndpoint endpoint = new FakeEndpoint();
+        endpoint.transfers.add(session(1, LENNY));
+        endpoint.transfers.add(session(2, "\u00AF\\_(\u30C4)_/\u00AF"));
+
+        Recorder recorder = run(endpoint);
+        assertEquals(2, recorder.texts.size());
+        assertEquals(LENNY, recorder.texts.get(0));
+        assertEquals("\u00AF\\_(\u30C4)_/\u00AF", recorder.texts.get(1));
+        assertEquals(4, endpoint.written.size());
+    }
+}
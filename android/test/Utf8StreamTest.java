@@ -0,0 +1,77 @@
+package com.picow.lennyface;
+
+import static org.junit.Assert.assertEquals;
+
+import java.nio.charset.StandardCharsets;
+import org.junit.Test;
+
+// Utf8Stream fed the way USB transfers arrive: a byte at a time, and in two
+// pieces split at every possible point
+public class Utf8StreamTest {
+
+    private static final String LENNY = "( \u0361\u00B0 \u035C\u0296 \u0361\u00B0 )";
+
+    private static String decode(int... bytes) {
+        Utf8Stream s = new Utf8Stream();
+        for (int b : bytes) s.feed((byte) b);
+        return s.finish();
+    }
+
+    @Test
+    public void splitAtEveryByte() {
+        String text = LENNY + " \u30C4 \uD83D\uDE00";  // 2-, 3- and 4-byte sequences
+        byte[] bytes = text.getBytes(StandardCharsets.UTF_8);
+
+        for (int at = 0; at <= bytes.length; at++) {
+            Utf8Stream s = new Utf8Stream();
+            s.feed(bytes, 0, at);
+            s.feed(bytes, at, bytes.length - at);
+            assertEquals("split at " + at, text, s.finish());
+        }
+    }
+
+    @Test
+    public void oneByteAtATime() {
+        assertEquals("\u00B0", decode(0xC2, 0xB0));
+        assertEquals("\u30C4", decode(0xE3, 0x83, 0x84));
+        assertEquals("\uD83D\uDE00", decode(0xF0, 0x9F, 0x98, 0x80));
+    }
+
+    @Test
+    public void cutOffByFinish() {
+        Utf8Stream s = new Utf8Stream();
+        s.feed((byte) 0xE3);
+        s.feed((byte) 0x83);
+        assertEquals("\uFFFD", s.finish());
+
+        // Nothing of the cut-off sequence is left for the next message
+        s.feed((byte) 'A');
+        assertEquals("A", s.finish());
+    }
+
+    @Test
+    public void cutOffByTheNextSequence() {
+        assertEquals("\uFFFDA", decode(0xE3, 0x83, 'A'));
+        assertEquals("\uFFFD\u00B0", decode(0xE3, 0xC2, 0xB0));
+    }
+
+    @Test
+    public void malformed() {
+        assertEquals("\uFFFD", decode(0x80));                           // stray continuation
+        assertEquals("\uFFFD\uFFFD", decode(0xC0, 0x80));               // overlong lead byte
+        assertEquals("\uFFFD", decode(0xE0, 0x80, 0x80));               // overlong
+        assertEquals("\uFFFD", decode(0xED, 0xA0, 0x80));               // surrogate
+        assertEquals("\uFFFD", decode(0xF4, 0x90, 0x80, 0x80));         // above U+10FFFF
+    }
+
+    @Test
+    public void resetDropsPartialInput() {
+        Utf8Stream s = new Utf8Stream();
+        s.feed((byte) 'x');
+        s.feed((byte) 0xE3);
+        s.reset();
+        s.feed((byte) 0xC2);
+        s.feed((byte) 0xB0);
+        assertEquals("\u00B0", s.finish());
+    }
+}
@@ -0,0 +1,103 @@
+// Companion daemon handshake and text frames over CDC
+
+#include "companion.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "macro_library.h"
+
+#define FRAME_HEADER 5  // STX, type, seq, length
+
+static bool present = false;
+static bool waiting = false;
+static bool got_ack = false;      // COMPANION_ACK read, its seq byte next
+static uint8_t seq = 0;           // 7 bits - the reply sets bit 7
+static uint16_t offered_id;
+static absolute_time_t deadline;
+
+static uint32_t delivered = 0;
+static uint32_t timeouts = 0;
+static uint32_t failures = 0;
+
+void companion_line_coding(uint32_t bit_rate) {
+    present = (bit_rate == COMPANION_BAUD);
+}
+
+bool companion_present(void) {
+    return present && tud_cdc_connected();
+}
+
+// Header and payload go into the FIFO together or not at all
+static bool send_frame(uint8_t type, void const *payload, uint16_t len) {
+    if (tud_cdc_write_available() < FRAME_HEADER + (uint32_t)len) return false;
+
+    uint8_t header[FRAME_HEADER] = { COMPANION_STX, type, seq, (uint8_t)len, (uint8_t)(len >> 8) };
+    tud_cdc_write(header, FRAME_HEADER);
+    if (len) tud_cdc_write(payload, len);
+    tud_cdc_write_flush();
+    return true;
+}
+
+bool companion_offer(uint16_t id) {
+    if (!companion_present() || waiting) return false;
+
+    char const *text;
+    uint16_t len;
+    if (!macro_library_text(id, &text, &len)) return false;
+    // Both frames must fit now - log output only drains once we are done
+    if (tud_cdc_write_available() < 2 * FRAME_HEADER + (uint32_t)len) return false;
+
+    seq = (uint8_t)((seq + 1) & 0x7F);
+    if (!send_frame(COMPANION_PING, NULL, 0)) return false;
+
+    offered_id = id;
+    got_ack = false;
+    waiting = true;
+    deadline = make_timeout_time_ms(COMPANION_TIMEOUT_MS);
+    return true;
+}
+
+companion_result_t companion_task(void) {
+    if (!waiting) return COMPANION_NO_ANSWER;
+
+    // Only reply bytes are taken off the port; anything else stays for
+    // its own reader and holds up the reply behind it
+    uint8_t c;
+    while (tud_cdc_peek(&c)) {
+        if (c == COMPANION_ACK) got_ack = true;
+        else if (got_ack && (c & 0x80)) got_ack = false;
+        else break;
+        tud_cdc_read_char();
+        if (c != (seq | 0x80)) continue;  // the ACK, or a late reply to an earlier ping
+
+        // The library may have been replaced since the offer, and the log
+        // may have taken the room in the FIFO
+        char const *text;
+        uint16_t len;
+        waiting = false;
+        if (!macro_library_text(offered_id, &text, &len) || !send_frame(COMPANION_TEXT, text, len)) {
+            failures++;
+            return COMPANION_NO_ANSWER;
+        }
+        delivered++;
+        return COMPANION_DELIVERED;
+    }
+
+    if (!tud_cdc_connected() || time_reached(deadline)) {
+        waiting = false;
+        timeouts++;
+        return COMPANION_NO_ANSWER;
+    }
+    return COMPANION_WAITING;
+}
+
+uint32_t companion_delivered(void) {
+    return delivered;
+}
+
+uint32_t companion_timeouts(void) {
+    return timeouts;
+}
+
+uint32_t companion_failures(void) {
+    return failures;
+}
@@ -0,0 +1,66 @@
+#ifndef COMPANION_H
+#define COMPANION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Text injection through the host companion daemon (tools/lenny_companion)
+//
+// Typing a codepoint through an input method costs six or more reports;
+// the daemon instead takes the macro's UTF-8 text over CDC and inserts it
+// in one operation. The daemon announces itself by opening the port at
+// COMPANION_BAUD. Each trigger then runs a handshake before any text goes
+// out:
+//
+//   device -> host   STX 'P' seq 0 0                  are you there?
+//   host -> device   ACK seq|0x80                     yes, send it
+//   device -> host   STX 'T' seq len_lo len_hi utf8   insert this
+//
+// If the ACK does not arrive within COMPANION_TIMEOUT_MS the text is never
+// sent and the caller types the macro over HID instead, so a slow or dead
+// daemon cannot cause a double insert; neither can a reply that comes too
+// late, or an ACK whose text frame cannot be sent after all. Frames are
+// written whole, so they can share the port with log output; the daemon
+// skips everything else.
+//
+// The handshake only takes reply bytes off the port. Other input (debug
+// commands) stays for its own reader, but until that has read it, a reply
+// queued behind it is not seen and the handshake times out. Neither reply
+// byte is printable, so stray ones are ignored by CDC command handlers.
+
+#define COMPANION_BAUD        1000000
+#define COMPANION_TIMEOUT_MS  50
+
+#define COMPANION_STX         0x02
+#define COMPANION_ACK         0x06
+#define COMPANION_PING        'P'
+#define COMPANION_TEXT        'T'
+
+typedef enum {
+    COMPANION_WAITING,     // handshake in progress
+    COMPANION_DELIVERED,   // text sent to the daemon
+    COMPANION_NO_ANSWER,   // type it over HID instead
+} companion_result_t;
+
+// Call from tud_cdc_line_coding_cb() - the daemon opens the port at
+// COMPANION_BAUD, anything else (a terminal) turns it off
+void companion_line_coding(uint32_t bit_rate);
+
+// True if a daemon has the port open
+bool companion_present(void);
+
+// Start the handshake for a macro. Returns false (send nothing, type it)
+// if no daemon is present or the macro has no text that fits a frame.
+bool companion_offer(uint16_t id);
+
+// Advance the handshake. Call every loop until it stops returning
+// COMPANION_WAITING.
+companion_result_t companion_task(void);
+
+// Handshakes answered, timed out, and answered but not delivered (the
+// macro was gone or the text did not fit the FIFO) since boot
+uint32_t companion_delivered(void);
+uint32_t companion_timeouts(void);
+uint32_t companion_failures(void);
+
+#endif
@@ -0,0 +1,194 @@
+// Config store - wear-levelled key/value log in the top flash sectors
+
+#include <string.h>
+#include "config_store.h"
+#include "hardware/flash.h"
+#include "flash_op.h"
+
+#define STORE_MAGIC        0x47464E4C  // "LNFG"
+#define STORE_SECTORS      ((int)(CONFIG_STORE_SIZE / FLASH_SECTOR_SIZE))
+#define RECORDS_PER_SECTOR (FLASH_SECTOR_SIZE / sizeof(record_t))  // slot 0 is the header
+
+#define RECORD_FREE   0xFF  // key of an erased slot
+#define RECORD_SET    0x01  // flags: value is valid; 0 = cleared
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+} sector_header_t;
+
+typedef struct {
+    uint8_t key;
+    uint8_t flags;
+    uint16_t crc;       // CRC-16/CCITT of key, flags and value
+    uint32_t value;
+} record_t;
+
+// RAM view, loaded at boot and kept in step with every write
+static uint32_t values[CONFIG_KEY_COUNT];
+static uint32_t present = 0;  // bit per key
+static void (*on_change)(config_key_t key);
+
+static int live = -1;         // sector being appended to, -1 = store empty
+static int prepared = -1;     // sector erased ahead by config_store_prepare()
+static uint32_t sequence = 0;
+static uint16_t next_slot = RECORDS_PER_SECTOR;
+static uint8_t page[FLASH_PAGE_SIZE];
+
+static inline uint32_t sector_offset(int n) {
+    return CONFIG_STORE_OFFSET + (uint32_t)n * FLASH_SECTOR_SIZE;
+}
+
+static inline void const *flash_at(uint32_t offset) {
+    return (void const *)(XIP_BASE + offset);
+}
+
+static uint16_t record_crc(record_t const *r) {
+    uint8_t bytes[6] = { r->key, r->flags, (uint8_t)r->value, (uint8_t)(r->value >> 8),
+                         (uint8_t)(r->value >> 16), (uint8_t)(r->value >> 24) };
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < 6; i++) {
+        crc ^= (uint16_t)(bytes[i] << 8);
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static void apply(record_t const *r) {
+    if (r->flags & RECORD_SET) {
+        values[r->key] = r->value;
+        present |= 1u << r->key;
+    } else {
+        present &= ~(1u << r->key);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Loading
+//--------------------------------------------------------------------+
+
+void config_store_init(void (*changed)(config_key_t key)) {
+    on_change = changed;
+    for (int n = 0; n < STORE_SECTORS; n++) {
+        sector_header_t const *h = flash_at(sector_offset(n));
+        if (h->magic == STORE_MAGIC && (live < 0 || h->sequence > sequence)) {
+            live = n;
+            sequence = h->sequence;
+        }
+    }
+    if (live < 0) return;
+
+    // Replay in order; a torn record fails its CRC and is skipped
+    record_t const *r = flash_at(sector_offset(live));
+    for (next_slot = 1; next_slot < RECORDS_PER_SECTOR; next_slot++) {
+        record_t const *rec = &r[next_slot];
+        if (rec->key == RECORD_FREE && rec->flags == 0xFF && rec->crc == 0xFFFF && rec->value == 0xFFFFFFFF) break;
+        if (rec->key < CONFIG_KEY_COUNT && rec->crc == record_crc(rec)) apply(rec);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Writing
+//--------------------------------------------------------------------+
+
+// Program bytes into an erased area; the rest of their page is left as is
+static void program(uint32_t offset, void const *data, uint32_t len) {
+    uint32_t page_start = offset & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page + (offset - page_start), data, len);
+    flash_op_program(page_start, page, FLASH_PAGE_SIZE);
+}
+
+static record_t make_record(uint8_t key, uint8_t flags, uint32_t value) {
+    record_t r = { key, flags, 0, value };
+    r.crc = record_crc(&r);
+    return r;
+}
+
+static inline int next_sector(void) {
+    return live < 0 ? 0 : (live + 1) % STORE_SECTORS;
+}
+
+// Start the next sector with the current value of every key. Its header
+// goes in last, so until then the old sector stays live.
+static void rotate(void) {
+    int target = next_sector();
+    if (target != prepared) flash_op_erase(sector_offset(target), FLASH_SECTOR_SIZE);
+    prepared = -1;
+
+    record_t records[CONFIG_KEY_COUNT];
+    uint16_t n = 0;
+    for (uint8_t key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (present & (1u << key)) records[n++] = make_record(key, RECORD_SET, values[key]);
+    }
+    if (n) program(sector_offset(target) + sizeof(record_t), records, n * sizeof(record_t));
+
+    sector_header_t h = { STORE_MAGIC, sequence + 1 };
+    program(sector_offset(target), &h, sizeof(h));
+
+    live = target;
+    sequence = h.sequence;
+    next_slot = 1 + n;
+}
+
+static bool append(uint8_t key, uint8_t flags, uint32_t value) {
+    if (live < 0 || next_slot >= RECORDS_PER_SECTOR) rotate();
+
+    record_t r = make_record(key, flags, value);
+    uint32_t offset = sector_offset(live) + next_slot * sizeof(record_t);
+    program(offset, &r, sizeof(r));
+    next_slot++;
+
+    if (memcmp(flash_at(offset), &r, sizeof(r)) != 0) return false;
+    apply(&r);
+    if (on_change) on_change((config_key_t)key);
+    return true;
+}
+
+bool config_store_write_erases(void) {
+    return (live < 0 || next_slot >= RECORDS_PER_SECTOR) && next_sector() != prepared;
+}
+
+// Nothing reads the next sector - it holds an older copy of the store at
+// most - so it can be erased any time before rotate() needs it
+void config_store_prepare(void) {
+    if (!config_store_write_erases()) return;
+    prepared = next_sector();
+    flash_op_erase(sector_offset(prepared), FLASH_SECTOR_SIZE);
+}
+
+bool config_store_set(config_key_t key, uint32_t value) {
+    if (key >= CONFIG_KEY_COUNT) return false;
+    if (config_store_is_set(key) && values[key] == value) return true;
+    return append((uint8_t)key, RECORD_SET, value);
+}
+
+bool config_store_clear(config_key_t key) {
+    if (key >= CONFIG_KEY_COUNT) return false;
+    if (!config_store_is_set(key)) return true;
+    return append((uint8_t)key, 0, 0);
+}
+
+//--------------------------------------------------------------------+
+// Lookups
+//--------------------------------------------------------------------+
+
+uint32_t config_store_get(config_key_t key, uint32_t fallback) {
+    return config_store_is_set(key) ? values[key] : fallback;
+}
+
+bool config_store_is_set(config_key_t key) {
+    return key < CONFIG_KEY_COUNT && (present & (1u << key));
+}
+
+uint8_t config_store_sector(void) {
+    return live < 0 ? 0 : (uint8_t)live;
+}
+
+uint32_t config_store_sequence(void) {
+    return sequence;
+}
+
+uint16_t config_store_free(void) {
+    return live < 0 ? 0 : (uint16_t)(RECORDS_PER_SECTOR - next_slot);
+}
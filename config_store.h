@@ -0,0 +1,65 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Persistent settings - a log-structured key/value store in the top 64 KB
+// of flash
+//
+// Each of the 16 sectors starts with a header {magic, sequence} and holds
+// 8-byte records {key, flags, crc16, value} appended in order. The sector
+// with the highest valid sequence is the live one; later records for a key
+// override earlier ones. When it fills up, the current value of every key
+// is copied into the next sector in the ring, and that sector's header is
+// programmed last. Sectors are reused round-robin, so each is erased once
+// every 16 * 511 writes. A reset during a write loses at most that write:
+// a torn record fails its CRC, and a sector without a header is ignored.
+//
+// The whole store is read once at boot into RAM; lookups never touch
+// flash. Writes go through flash_op.h.
+
+#define CONFIG_STORE_SIZE    (64 * 1024)
+#define CONFIG_STORE_OFFSET  (PICO_FLASH_SIZE_BYTES - CONFIG_STORE_SIZE)  // from the start of flash
+
+typedef enum {
+    CONFIG_DEBOUNCE_MS,     // trigger pins; from the next start
+    CONFIG_COOLDOWN_MS,     // minimum time between triggers
+    CONFIG_MIN_GAP_US,      // floor for the inter-report gap (hid_queue.h)
+    CONFIG_MACRO,           // macro typed on trigger
+    CONFIG_LAYOUT,          // host keyboard layout (keymap.h)
+    CONFIG_BURST_MS,        // hold time before a trigger repeats, 0 = never
+    CONFIG_KEY_COUNT
+} config_key_t;
+
+// Names for tools and logs, in config_key_t order
+#define CONFIG_KEY_NAMES { "debounce_ms", "cooldown_ms", "min_gap_us", "macro", "layout", "burst_ms" }
+
+// Load the store into RAM. Call once at start-up, before input_launch().
+// on_change (may be NULL) is called after a write has changed a key, to
+// apply it live.
+void config_store_init(void (*on_change)(config_key_t key));
+
+// Stored value for key, or fallback if it was never set
+uint32_t config_store_get(config_key_t key, uint32_t fallback);
+bool config_store_is_set(config_key_t key);
+
+// Write a value (or clear it, so get() returns the fallback again).
+// Nothing is written if it would not change. Returns false for an unknown
+// key or if the record did not read back from flash.
+bool config_store_set(config_key_t key, uint32_t value);
+bool config_store_clear(config_key_t key);
+
+// Every 511th write starts a new sector, which takes a sector erase (~45 ms
+// with interrupts off). Code in a TinyUSB callback checks for that first
+// and runs config_store_prepare() from a scheduler task (sched.h), so the
+// write itself only programs pages.
+bool config_store_write_erases(void);
+void config_store_prepare(void);
+
+// Live sector, its sequence number and the records still free in it
+uint8_t config_store_sector(void);
+uint32_t config_store_sequence(void);
+uint16_t config_store_free(void);
+
+#endif
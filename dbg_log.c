@@ -0,0 +1,198 @@
+// Deferred debug log - binary records in a ring, formatted when idle
+
+#include "dbg_log.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include "tusb.h"
+
+typedef struct {
+    char const *fmt;
+    uint8_t argc;
+    uintptr_t args[DBG_LOG_MAX_ARGS];
+} log_record_t;
+
+static log_record_t ring[DBG_LOG_RECORDS];
+static uint32_t head = 0;  // free-running
+static uint32_t tail = 0;
+static uint32_t dropped = 0;
+static uint32_t dropped_reported = 0;
+
+// The record being sent, formatted
+static char line[DBG_LOG_LINE_MAX];
+static uint16_t line_len = 0;
+static uint16_t line_pos = 0;
+
+//--------------------------------------------------------------------+
+// Recording
+//--------------------------------------------------------------------+
+
+void dbg_log(char const *fmt, ...) {
+    if (head - tail == DBG_LOG_RECORDS) {
+        dropped++;
+        return;
+    }
+    log_record_t *r = &ring[head & (DBG_LOG_RECORDS - 1)];
+    r->fmt = fmt;
+
+    // Capture one argument per conversion; formatting waits for the drain
+    uint8_t argc = 0;
+    va_list args;
+    va_start(args, fmt);
+    for (char const *p = fmt; *p && argc < DBG_LOG_MAX_ARGS; p++) {
+        if (*p != '%') continue;
+        p++;
+        while (*p == '-' || *p == '0' || (*p >= '1' && *p <= '9') || *p == 'l') p++;
+        if (*p == '\0') break;
+        if (*p == 's' || *p == 'p') {
+            r->args[argc++] = (uintptr_t)va_arg(args, void const *);
+        } else if (*p != '%') {
+            r->args[argc++] = va_arg(args, unsigned);
+        }
+    }
+    va_end(args);
+    r->argc = argc;
+    head++;
+}
+
+bool dbg_log_pending(void) {
+    return head != tail || line_pos < line_len;
+}
+
+uint32_t dbg_log_dropped(void) {
+    return dropped;
+}
+
+//--------------------------------------------------------------------+
+// Formatting
+//--------------------------------------------------------------------+
+
+typedef struct {
+    char *buf;
+    uint16_t len;
+} out_t;
+
+static void put(out_t *o, char c) {
+    if (o->len < DBG_LOG_LINE_MAX) o->buf[o->len++] = c;
+}
+
+static void put_field(out_t *o, char const *s, uint16_t n, uint8_t width, bool left, char pad) {
+    if (!left) for (uint16_t i = n; i < width; i++) put(o, pad);
+    for (uint16_t i = 0; i < n; i++) put(o, s[i]);
+    if (left) for (uint16_t i = n; i < width; i++) put(o, ' ');
+}
+
+static uint16_t format(char *buf, char const *fmt, uintptr_t const *args, uint8_t argc) {
+    static const char hex_lower[] = "0123456789abcdef";
+    static const char hex_upper[] = "0123456789ABCDEF";
+    out_t o = { buf, 0 };
+    uint8_t next = 0;
+
+    for (char const *p = fmt; *p; p++) {
+        if (*p != '%') {
+            put(&o, *p);
+            continue;
+        }
+        p++;
+        bool left = false;
+        char pad = ' ';
+        uint8_t width = 0;
+        for (; *p == '-' || *p == '0'; p++) {
+            if (*p == '-') left = true;
+            else pad = '0';
+        }
+        for (; *p >= '0' && *p <= '9'; p++) width = (uint8_t)(width * 10 + (*p - '0'));
+        while (*p == 'l') p++;
+        if (*p == '\0') break;
+        if (*p == '%') {
+            put(&o, '%');
+            continue;
+        }
+
+        uintptr_t arg = next < argc ? args[next++] : 0;
+        char digits[2 + 2 * sizeof(uintptr_t)];
+        uint16_t n = 0;
+
+        switch (*p) {
+            case 's': {
+                char const *s = arg ? (char const *)arg : "(null)";
+                uint16_t len = 0;
+                while (s[len]) len++;
+                put_field(&o, s, len, width, left, ' ');
+                continue;
+            }
+            case 'c':
+                digits[n++] = (char)arg;
+                break;
+            case 'd':
+            case 'i':
+            case 'u': {
+                uint32_t v = (uint32_t)arg;
+                bool negative = (*p != 'u') && (int32_t)v < 0;
+                if (negative) v = (uint32_t)-(int32_t)v;
+                char tmp[10];
+                uint16_t t = 0;
+                do { tmp[t++] = (char)('0' + v % 10); v /= 10; } while (v);
+                if (negative) digits[n++] = '-';
+                while (t) digits[n++] = tmp[--t];
+                break;
+            }
+            case 'x':
+            case 'X':
+            case 'p': {
+                char const *hex = (*p == 'X') ? hex_upper : hex_lower;
+                uintptr_t v = (*p == 'p') ? arg : (uint32_t)arg;
+                char tmp[2 * sizeof(uintptr_t)];
+                uint16_t t = 0;
+                do { tmp[t++] = hex[v & 0xF]; v >>= 4; } while (v);
+                if (*p == 'p') { digits[n++] = '0'; digits[n++] = 'x'; }
+                while (t) digits[n++] = tmp[--t];
+                break;
+            }
+            default:  // unsupported - print it as written
+                digits[n++] = '%';
+                digits[n++] = *p;
+                break;
+        }
+        put_field(&o, digits, n, width, left, left ? ' ' : pad);
+    }
+    return o.len;
+}
+
+//--------------------------------------------------------------------+
+// Draining
+//--------------------------------------------------------------------+
+
+void dbg_log_drain(void) {
+    if (!tud_cdc_connected()) {
+        tail = head;
+        line_pos = line_len = 0;
+        return;
+    }
+
+    while (true) {
+        if (line_pos == line_len) {
+            if (dropped != dropped_reported) {
+                uintptr_t n = dropped - dropped_reported;
+                dropped_reported = dropped;
+                line_len = format(line, "LOG: %lu records dropped\r\n", &n, 1);
+            } else if (tail != head) {
+                log_record_t const *r = &ring[tail & (DBG_LOG_RECORDS - 1)];
+                line_len = format(line, r->fmt, r->args, r->argc);
+                tail++;
+            } else {
+                break;
+            }
+            line_pos = 0;
+        }
+
+        // TinyUSB queues a packet every time 64 bytes are buffered
+        uint32_t room = tud_cdc_write_available();
+        if (room == 0) return;  // FIFO full - resume next time
+        uint32_t n = (uint32_t)(line_len - line_pos);
+        if (n > room) n = room;
+        line_pos = (uint16_t)(line_pos + tud_cdc_write(line + line_pos, n));
+    }
+
+    // Caught up: send the short tail packet too
+    tud_cdc_write_flush();
+}
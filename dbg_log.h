@@ -0,0 +1,38 @@
+#ifndef DBG_LOG_H
+#define DBG_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Deferred debug log for the CDC port
+//
+// dbg_log() only stores a binary record - the format string pointer plus
+// its raw arguments - in a ring; nothing is formatted or sent. The log
+// task (an idle task, sched.h) calls dbg_log_drain(), which formats records
+// with a small built-in formatter and hands them to the CDC FIFO, which
+// goes out in full 64-byte packets. A keystroke log line costs a few
+// hundred cycles instead of a vsnprintf and a USB flush, so the debug
+// build keeps production timing.
+//
+// Core0 only, never from an interrupt. The format string and any %s
+// argument must stay valid until drained (string literals, flash tables).
+// Conversions: %d %i %u %x %X %c %s %p %%, with '-', '0', a width and an
+// ignored 'l'. Every integer argument is taken as 32 bits.
+
+#define DBG_LOG_RECORDS  128  // ring size in records (power of two)
+#define DBG_LOG_MAX_ARGS 6    // arguments beyond this are dropped
+#define DBG_LOG_LINE_MAX 160  // longest formatted record
+
+void dbg_log(char const *fmt, ...);
+
+// Format and send as much as the CDC FIFO takes. Records are discarded
+// while no terminal is connected.
+void dbg_log_drain(void);
+
+// Records waiting to be sent
+bool dbg_log_pending(void);
+
+// Records lost because the ring was full
+uint32_t dbg_log_dropped(void);
+
+#endif
@@ -0,0 +1,24 @@
+// Flash erase/program with core1 parked and interrupts off
+
+#include "flash_op.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "input.h"
+
+void flash_op_erase(uint32_t offset, uint32_t len) {
+    for (uint32_t done = 0; done < len; done += FLASH_SECTOR_SIZE) {
+        input_park();
+        uint32_t irq = save_and_disable_interrupts();
+        flash_range_erase(offset + done, FLASH_SECTOR_SIZE);
+        restore_interrupts(irq);
+        input_unpark();
+    }
+}
+
+void flash_op_program(uint32_t offset, void const *data, uint32_t len) {
+    input_park();
+    uint32_t irq = save_and_disable_interrupts();
+    flash_range_program(offset, data, len);
+    restore_interrupts(irq);
+    input_unpark();
+}
@@ -0,0 +1,22 @@
+#ifndef FLASH_OP_H
+#define FLASH_OP_H
+
+#include <stdint.h>
+
+// Erasing and programming the flash the firmware runs from
+//
+// Both cores execute through XIP, which is unavailable while the flash is
+// busy. Every operation parks core1 in RAM (input_park()) and runs with
+// core0's interrupts off. Erases go one 4 KB sector at a time with
+// interrupts back on in between, so the USB interrupt is never held off
+// longer than one sector erase (~45 ms) and the device stays enumerated.
+// Core0 only, from the main loop or a TinyUSB callback.
+
+// offset and len in bytes from the start of flash, FLASH_SECTOR_SIZE aligned
+void flash_op_erase(uint32_t offset, uint32_t len);
+
+// offset and len FLASH_PAGE_SIZE aligned. Bits only go from 1 to 0, so a
+// page can be programmed again with 0xFF over the bytes already written.
+void flash_op_program(uint32_t offset, void const *data, uint32_t len);
+
+#endif
@@ -0,0 +1,354 @@
+// Non-blocking HID report queue
+// Typing code enqueues reports; one report goes out per completed IN transfer,
+// no sooner than the adaptive inter-report gap allows. Tables are queued by
+// reference and read in place, so a macro streams straight out of flash. In
+// the report protocol, runs of taps from a table share one NKRO report.
+
+#include <string.h>
+#include "hid_queue.h"
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+typedef struct {
+    hid_report_t const *table;  // next report of a queued table, or NULL
+    uint16_t left;              // reports left in table
+    hid_report_t report;        // single report when table is NULL
+} queue_slot_t;
+
+static queue_slot_t queue[HID_QUEUE_SIZE];
+static uint16_t head = 0;  // slot holding the next report to send
+static uint16_t tail = 0;  // next free slot
+static bool in_flight = false;
+static bool slot_ending = false;  // the report in flight is the last of its slot
+static bool boot_protocol = false;
+static uint8_t held[HID_NKRO_USAGES / 8];  // keys down in the last report sent
+
+static uint32_t retries = 0;
+static uint32_t reports_sent = 0;
+static uint32_t push_failures = 0;
+static uint32_t discarded = 0;
+static uint32_t slots_done = 0;
+static uint32_t sequences = 0;
+static uint32_t max_sequence_us = 0;
+static uint64_t sequence_start = 0;
+static uint64_t first_submit = 0;
+static uint16_t sequence_count = 0;
+static uint16_t sequence_taken = 0;   // queued reports sent, several per NKRO report
+static uint16_t sequence_acked = 0;
+static uint64_t first_ack = 0;
+static uint64_t last_ack = 0;
+static uint32_t last_sequence_us = 0;
+static uint16_t last_sequence_len = 0;
+
+// Pacing - the gap starts at the endpoint's fastest rate and never drops
+// below the host's own pace (host_accept_us). It is doubled when a report
+// is refused or its completion is overdue, then creeps back down over clean
+// sequences
+static uint32_t min_gap_us = HID_PACING_MIN_GAP_US;
+static uint32_t gap_us = HID_PACING_MIN_GAP_US;
+static uint32_t host_accept_us = HID_PACING_MIN_GAP_US;  // smoothed submit -> complete time
+static uint64_t last_submit = 0;
+static bool loss_in_sequence = false;
+static bool refused = false;  // the head report was refused, loss already counted
+static bool overdue = false;  // the transfer in flight missed its deadline, ditto
+static bool was_mounted = false;
+
+static inline uint16_t queue_count(void) {
+    return (uint16_t)(tail - head);
+}
+
+void hid_queue_init(void) {
+    head = tail = 0;
+    in_flight = false;
+    hid_queue_pacing_reset();
+}
+
+void hid_queue_pacing_reset(void) {
+    gap_us = min_gap_us;
+    host_accept_us = HID_PACING_MIN_GAP_US;
+    loss_in_sequence = false;
+    refused = false;
+    overdue = false;
+}
+
+// The gap may not go below this: the configured minimum, or the rate the
+// host has actually been taking reports at if that is slower
+static uint32_t gap_floor(void) {
+    uint32_t us = host_accept_us > min_gap_us ? host_accept_us : min_gap_us;
+    return us < HID_PACING_MAX_GAP_US ? us : HID_PACING_MAX_GAP_US;
+}
+
+static queue_slot_t *claim_slot(void) {
+    if (queue_count() >= HID_QUEUE_SIZE) {
+        push_failures++;
+        return NULL;
+    }
+
+    if (!in_flight && queue_count() == 0) {
+        sequence_start = time_us_64();
+        sequence_count = 0;
+        sequence_taken = 0;
+        sequence_acked = 0;
+        loss_in_sequence = false;
+    }
+    return &queue[tail & (HID_QUEUE_SIZE - 1)];
+}
+
+bool hid_queue_push(uint8_t modifier, uint8_t keycode) {
+    queue_slot_t *s = claim_slot();
+    if (!s) return false;
+
+    s->table = NULL;
+    s->left = 1;
+    s->report.modifier = modifier;
+    s->report.keycode = keycode;
+    tail++;
+    return true;
+}
+
+bool hid_queue_push_table(hid_report_t const *reports, uint16_t count) {
+    if (count == 0) return true;
+
+    queue_slot_t *s = claim_slot();
+    if (!s) return false;
+
+    s->table = reports;
+    s->left = count;
+    tail++;
+    return true;
+}
+
+bool hid_queue_busy(void) {
+    return in_flight || queue_count() != 0;
+}
+
+uint16_t hid_queue_pending(void) {
+    return (uint16_t)(queue_count() + slot_ending);
+}
+
+uint8_t hid_queue_progress(void) {
+    uint32_t left = 0;
+    for (uint16_t i = head; i != tail; i++) left += queue[i & (HID_QUEUE_SIZE - 1)].left;
+    uint32_t total = sequence_taken + left;
+    return total ? (uint8_t)(sequence_taken * 255u / total) : 255;
+}
+
+static inline bool key_in(uint8_t const *bits, uint8_t keycode) {
+    return keycode < HID_NKRO_USAGES && (bits[keycode / 8] & (1u << (keycode % 8)));
+}
+
+static inline void key_set(uint8_t *bits, uint8_t keycode) {
+    if (keycode && keycode < HID_NKRO_USAGES) bits[keycode / 8] |= (uint8_t)(1u << (keycode % 8));
+}
+
+// How many reports from the head of r can go out as one NKRO report. Each
+// one joining the first must keep its modifiers and press a new key that
+// sorts after the previous one and was not down in the last report, and
+// the report after it must not press a key of the group again - the host
+// would see it still held. Never the last report of a table, so the next
+// slot starts clean.
+//
+// A report has one modifier byte for all its keys, so a chord such as
+// Ctrl+Shift+U cannot take the plain hex digits after it along - the host
+// would type them with Ctrl+Shift held. Nothing is lost by that: key_stream
+// already lets go of the chord in the report that presses the first digit,
+// and the group starts there.
+static uint16_t group_len(hid_report_t const *r, uint16_t left) {
+    uint16_t n = 1;
+    while (n < HID_NKRO_GROUP_MAX && n + 1 < left) {
+        uint8_t key = r[n].keycode;
+        if (r[n].modifier != r[0].modifier || key == 0 || key >= HID_NKRO_USAGES) break;
+        if (key <= r[n - 1].keycode || key_in(held, key)) break;
+
+        uint8_t next = r[n + 1].keycode;
+        bool repeated = false;
+        for (uint16_t i = 0; i <= n; i++) repeated |= (next != 0 && r[i].keycode == next);
+        if (repeated) break;
+        n++;
+    }
+    return n;
+}
+
+// Try to hand the head report to TinyUSB. The report stays queued if the
+// endpoint refuses it, so the next call retries instead of dropping a key.
+static void send_next(void) {
+    if (in_flight || queue_count() == 0) return;
+    if (!tud_hid_ready()) return;
+
+    uint64_t now = time_us_64();
+    if (sequence_count != 0 && now - last_submit < gap_us) return;
+
+    queue_slot_t *s = &queue[head & (HID_QUEUE_SIZE - 1)];
+    hid_report_t const *r = s->table ? s->table : &s->report;
+    uint16_t n = 1;
+    bool sent;
+    if (HID_NKRO && !boot_protocol) {
+        if (s->table) n = group_len(r, s->left);
+        uint8_t report[HID_NKRO_REPORT_LEN] = { r->modifier };
+        for (uint16_t i = 0; i < n; i++) key_set(&report[1], r[i].keycode);
+        sent = tud_hid_n_report(0, 0, report, sizeof(report));
+    } else {
+        uint8_t keys[6] = {r->keycode, 0, 0, 0, 0, 0};
+        sent = tud_hid_keyboard_report(0, r->modifier, keys);
+    }
+    if (!sent) {
+        // Once per report - the next pass tries the same one again
+        retries++;
+        if (!refused) hid_queue_report_loss();
+        refused = true;
+        return;
+    }
+    refused = false;
+    overdue = false;
+
+    memset(held, 0, sizeof(held));
+    for (uint16_t i = 0; i < n; i++) key_set(held, r[i].keycode);
+    if (s->table) s->table += n;
+    s->left -= n;
+    slot_ending = (s->left == 0);
+    if (slot_ending) head++;
+    sequence_taken += n;
+    in_flight = true;
+    if (sequence_count == 0) first_submit = now;
+    sequence_count++;
+    last_submit = now;
+}
+
+void hid_queue_task(void) {
+    // Host went away mid-sequence - the pending transfer will never complete
+    if (!tud_mounted()) {
+        for (uint16_t i = head; i != tail; i++) discarded += queue[i & (HID_QUEUE_SIZE - 1)].left;
+        head = tail;
+        in_flight = false;
+        slot_ending = false;
+        was_mounted = false;
+        boot_protocol = false;
+        return;
+    }
+
+    // New host (or re-enumeration) - start again from the fastest rate
+    if (!was_mounted) {
+        hid_queue_pacing_reset();
+        was_mounted = true;
+    }
+
+    // The host stopped taking reports at its usual pace
+    if (in_flight && !overdue && time_us_64() - last_submit > HID_PACING_LATE_GAPS * gap_us) {
+        overdue = true;
+        hid_queue_report_loss();
+    }
+    send_next();
+}
+
+void hid_queue_report_complete(void) {
+    uint64_t now = time_us_64();
+    in_flight = false;
+    reports_sent++;
+    if (slot_ending) slots_done++;
+    slot_ending = false;
+    if (sequence_acked++ == 0) first_ack = now;
+
+    // How fast the host actually takes reports off the endpoint
+    int32_t sample = (int32_t)(now - last_submit);
+    host_accept_us = (uint32_t)((int32_t)host_accept_us + (sample - (int32_t)host_accept_us) / 8);
+    if (gap_us < gap_floor()) gap_us = gap_floor();
+
+    if (queue_count() == 0) {
+        last_ack = now;
+        last_sequence_us = (uint32_t)(now - sequence_start);
+        last_sequence_len = sequence_count;
+        sequences++;
+        if (last_sequence_us > max_sequence_us) max_sequence_us = last_sequence_us;
+
+        // A clean sequence earns a slightly tighter gap next time
+        if (!loss_in_sequence && gap_us > gap_floor()) {
+            gap_us -= gap_us / 8;
+            if (gap_us < gap_floor()) gap_us = gap_floor();
+        }
+        return;
+    }
+    send_next();
+}
+
+void hid_queue_set_boot_protocol(bool boot) {
+    boot_protocol = boot;
+}
+
+bool hid_queue_boot_protocol(void) {
+    return boot_protocol;
+}
+
+void hid_queue_report_loss(void) {
+    loss_in_sequence = true;
+    gap_us *= 2;
+    if (gap_us > HID_PACING_MAX_GAP_US) gap_us = HID_PACING_MAX_GAP_US;
+}
+
+uint32_t hid_queue_gap_us(void) {
+    return gap_us;
+}
+
+void hid_queue_set_gap_us(uint32_t us) {
+    if (us < gap_floor()) us = gap_floor();
+    if (us > HID_PACING_MAX_GAP_US) us = HID_PACING_MAX_GAP_US;
+    gap_us = us;
+}
+
+void hid_queue_set_min_gap_us(uint32_t us) {
+    if (us < HID_PACING_MIN_GAP_US) us = HID_PACING_MIN_GAP_US;
+    if (us > HID_PACING_MAX_GAP_US) us = HID_PACING_MAX_GAP_US;
+    min_gap_us = us;
+    if (gap_us < gap_floor()) gap_us = gap_floor();
+}
+
+uint32_t hid_queue_host_accept_us(void) {
+    return host_accept_us;
+}
+
+uint32_t hid_queue_retries(void) {
+    return retries;
+}
+
+uint32_t hid_queue_sequence_us(void) {
+    return last_sequence_us;
+}
+
+uint64_t hid_queue_first_report_time(void) {
+    return first_submit;
+}
+
+uint32_t hid_queue_reports_sent(void) {
+    return reports_sent;
+}
+
+uint32_t hid_queue_push_failures(void) {
+    return push_failures;
+}
+
+uint32_t hid_queue_discarded(void) {
+    return discarded;
+}
+
+uint32_t hid_queue_slots_done(void) {
+    return slots_done;
+}
+
+uint32_t hid_queue_sequences(void) {
+    return sequences;
+}
+
+uint32_t hid_queue_sequence_max_us(void) {
+    return max_sequence_us;
+}
+
+uint64_t hid_queue_first_ack_time(void) {
+    return first_ack;
+}
+
+uint64_t hid_queue_last_ack_time(void) {
+    return last_ack;
+}
+
+uint16_t hid_queue_sequence_len(void) {
+    return last_sequence_len;
+}
@@ -0,0 +1,133 @@
+#ifndef HID_QUEUE_H
+#define HID_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// One boot-protocol keyboard report with a single key slot in use
+typedef struct {
+    uint8_t modifier;
+    uint8_t keycode;
+} hid_report_t;
+
+// NKRO keyboard report. With HID_NKRO (the default) the keyboard interface
+// describes a report of the modifier byte and one bit per key usage
+// 0x00-0x77, and the queue packs a run of taps from a table into one report
+// where the host cannot tell the difference: same modifiers, keycodes
+// ascending (the order the host scans the bitmap in) and none already down.
+// When the host selects the boot protocol (BIOS, KVMs), reports fall back
+// to the 8-byte boot report with one key each.
+#ifndef HID_NKRO
+#define HID_NKRO 1
+#endif
+#define HID_NKRO_USAGES      120
+#define HID_NKRO_REPORT_LEN  (1 + HID_NKRO_USAGES / 8)
+#define HID_NKRO_GROUP_MAX   6   // keys pressed in one report at most
+
+// Keyboard report descriptor for the images; extra items go in the
+// application collection, as with TUD_HID_REPORT_DESC_KEYBOARD()
+#if HID_NKRO
+#define HID_QUEUE_REPORT_DESC_KEYBOARD(...) \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP ), \
+    HID_USAGE      ( HID_USAGE_DESKTOP_KEYBOARD ), \
+    HID_COLLECTION ( HID_COLLECTION_APPLICATION ), \
+        /* Modifiers: the boot report's first byte */ \
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD ), \
+        HID_USAGE_MIN  ( 224 ), \
+        HID_USAGE_MAX  ( 231 ), \
+        HID_LOGICAL_MIN( 0 ), \
+        HID_LOGICAL_MAX( 1 ), \
+        HID_REPORT_COUNT( 8 ), \
+        HID_REPORT_SIZE( 1 ), \
+        HID_INPUT      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        /* Keys: one bit each */ \
+        HID_USAGE_MIN  ( 0 ), \
+        HID_USAGE_MAX  ( HID_NKRO_USAGES - 1 ), \
+        HID_REPORT_COUNT( HID_NKRO_USAGES ), \
+        HID_INPUT      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        /* LEDs, as in the boot report */ \
+        HID_USAGE_PAGE ( HID_USAGE_PAGE_LED ), \
+        HID_USAGE_MIN  ( 1 ), \
+        HID_USAGE_MAX  ( 5 ), \
+        HID_REPORT_COUNT( 5 ), \
+        HID_OUTPUT     ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ), \
+        HID_REPORT_SIZE( 3 ), \
+        HID_REPORT_COUNT( 1 ), \
+        HID_OUTPUT     ( HID_CONSTANT ), \
+        __VA_ARGS__ \
+    HID_COLLECTION_END
+#else
+#define HID_QUEUE_REPORT_DESC_KEYBOARD(...) TUD_HID_REPORT_DESC_KEYBOARD(__VA_ARGS__)
+#endif
+
+// Queue slots (power of two). A single report or a whole table takes one slot.
+#define HID_QUEUE_SIZE 32
+
+// Inter-report gap limits. The minimum matches the endpoint's bInterval of
+// 1 ms at full speed; the maximum is the slowest the old fixed delays went.
+#define HID_PACING_MIN_GAP_US 1000
+#define HID_PACING_MAX_GAP_US 30000
+
+// A transfer still not completed this many gaps after it was submitted
+// counts as a loss
+#define HID_PACING_LATE_GAPS 4
+
+void hid_queue_init(void);
+
+// Queue a report for sending. Returns false if the ring is full.
+bool hid_queue_push(uint8_t modifier, uint8_t keycode);
+
+// Queue a whole precompiled table by reference - it is read in place while
+// sending, so it must stay valid (e.g. in flash) until drained. Returns false
+// if no slot is free.
+bool hid_queue_push_table(hid_report_t const *reports, uint16_t count);
+
+// True while reports are queued or a transfer is still in flight
+bool hid_queue_busy(void);
+
+// Slots the host has not acknowledged in full yet - a table counts once,
+// however long, until its last report completes
+uint16_t hid_queue_pending(void);
+
+// How far the current sequence is, 0-255 by queued reports taken
+uint8_t hid_queue_progress(void);
+
+// Starts the next transfer if the endpoint is idle. Call from the main loop.
+void hid_queue_task(void);
+
+// Call from tud_hid_report_complete_cb() - sends the next queued report
+void hid_queue_report_complete(void);
+
+// Call from tud_hid_set_protocol_cb() for the keyboard interface. Back to
+// the report protocol when the host goes away, as TinyUSB does.
+void hid_queue_set_boot_protocol(bool boot);
+bool hid_queue_boot_protocol(void);
+
+// Adaptive pacing. The gap between reports starts at the minimum and is
+// reset whenever the device is (re)mounted by a host. It follows the host's
+// smoothed accept time when that is slower, and doubles on a loss: a report
+// the endpoint refused, or a completion overdue by HID_PACING_LATE_GAPS
+// gaps. The minimum can be raised for hosts that need slower typing (config
+// store CONFIG_MIN_GAP_US).
+void hid_queue_report_loss(void);        // double the gap; also the debug 'l' command
+void hid_queue_pacing_reset(void);
+uint32_t hid_queue_gap_us(void);          // current inter-report gap
+void hid_queue_set_gap_us(uint32_t us);   // clamped to the minimum and the maximum
+void hid_queue_set_min_gap_us(uint32_t us);  // clamped to the limits above
+uint32_t hid_queue_host_accept_us(void);  // smoothed submit -> complete time
+
+// Statistics
+uint32_t hid_queue_retries(void);       // tud_hid_keyboard_report() refusals
+uint32_t hid_queue_reports_sent(void);  // reports the host acknowledged
+uint32_t hid_queue_push_failures(void); // pushes refused because the queue was full
+uint32_t hid_queue_discarded(void);     // queued reports thrown away when the host went away
+uint32_t hid_queue_slots_done(void);    // slots whose last report the host acknowledged
+uint32_t hid_queue_sequences(void);     // sequences drained since boot
+uint32_t hid_queue_sequence_us(void);   // duration of the last drained sequence
+uint32_t hid_queue_sequence_max_us(void);  // ... and the longest one
+uint16_t hid_queue_sequence_len(void);  // reports in the last drained sequence
+uint64_t hid_queue_first_report_time(void);  // time_us_64() of the latest sequence's first report
+uint64_t hid_queue_first_ack_time(void);     // ... when the host acknowledged its first report
+uint64_t hid_queue_last_ack_time(void);      // ... and its last one (set once drained)
+
+#endif
@@ -0,0 +1,76 @@
+// Host OS detection - descriptor request pattern during enumeration
+
+#include "host_detect.h"
+#include "tusb.h"
+#include "hardware/structs/usb.h"
+
+#define MS_OS_STRING_INDEX 0xEE
+
+// What has been seen since the last reset. Written from tud_task() only.
+static uint16_t config_first_len = 0;  // wLength of the first config request
+static bool config_full_read = false;  // a later config request asked for more
+static bool ms_os_string = false;
+static bool string_probe = false;      // a string requested with wLength 2
+static bool string_255 = false;        // a string requested with wLength 255
+static bool led_report = false;
+
+// wLength of the control request being answered, straight from the
+// setup packet in USB DPRAM - TinyUSB does not pass it to the callbacks
+static uint16_t request_length(void) {
+    return (uint16_t)(usb_dpram->setup_packet[6] | (usb_dpram->setup_packet[7] << 8));
+}
+
+void host_detect_descriptor(uint8_t type, uint8_t index) {
+    uint16_t len = request_length();
+
+    switch (type) {
+        case TUSB_DESC_CONFIGURATION:
+            if (config_first_len == 0) config_first_len = len;
+            else if (len > config_first_len) config_full_read = true;
+            break;
+        case TUSB_DESC_STRING:
+            if (index == MS_OS_STRING_INDEX) ms_os_string = true;
+            if (len == 2) string_probe = true;
+            if (len == 255) string_255 = true;
+            break;
+        default:
+            break;
+    }
+}
+
+void host_detect_led_report(void) {
+    led_report = true;
+}
+
+void host_detect_reset(void) {
+    config_first_len = 0;
+    config_full_read = false;
+    ms_os_string = false;
+    string_probe = false;
+    string_255 = false;
+    led_report = false;
+}
+
+host_os_t host_detect_os(void) {
+    if (ms_os_string || config_first_len == 255) return HOST_OS_WINDOWS;
+    if (string_probe && !led_report) return HOST_OS_MACOS;
+    if (config_first_len == 9 && config_full_read && string_255) return HOST_OS_LINUX;
+    return HOST_OS_UNKNOWN;
+}
+
+const char *host_detect_name(host_os_t os) {
+    switch (os) {
+        case HOST_OS_LINUX:   return "Linux";
+        case HOST_OS_WINDOWS: return "Windows";
+        case HOST_OS_MACOS:   return "macOS";
+        default:              return "unknown";
+    }
+}
+
+macro_method_t host_detect_method(macro_method_t fallback) {
+    switch (host_detect_os()) {
+        case HOST_OS_LINUX:   return MACRO_METHOD_LINUX;
+        case HOST_OS_WINDOWS: return MACRO_METHOD_WINDOWS;
+        default:              return fallback;
+    }
+}
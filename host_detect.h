@@ -0,0 +1,49 @@
+#ifndef HOST_DETECT_H
+#define HOST_DETECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "macro_library.h"
+
+// Host OS fingerprinting from enumeration behaviour
+//
+// Every host enumerates a little differently. The descriptor callbacks
+// report each request here (with wLength taken from the setup packet), as
+// does the first LED output report. The observed pattern is matched
+// against known host stacks:
+//
+//   Windows  asks for the configuration descriptor with wLength 255 up front,
+//            and asks for the Microsoft OS string (index 0xEE)
+//   macOS    probes string descriptors with wLength 2 before reading them,
+//            and leaves the keyboard LEDs alone
+//   Linux    asks for 9 bytes of configuration, then the full length, reads
+//            strings with wLength 255, and sets the LEDs once hid-input binds
+//
+// Anything that matches none of them stays HOST_OS_UNKNOWN, and the
+// caller's fallback (the trigger pin's method) is used instead.
+
+typedef enum {
+    HOST_OS_UNKNOWN,
+    HOST_OS_LINUX,
+    HOST_OS_WINDOWS,
+    HOST_OS_MACOS,
+} host_os_t;
+
+// Call from the descriptor callbacks (tud_descriptor_*_cb and
+// tud_hid_descriptor_report_cb) with the descriptor type being requested
+void host_detect_descriptor(uint8_t type, uint8_t index);
+
+// Call from tud_hid_set_report_cb() for output (LED) reports
+void host_detect_led_report(void);
+
+// Call from tud_umount_cb() - the next enumeration may be another host
+void host_detect_reset(void);
+
+host_os_t host_detect_os(void);
+const char *host_detect_name(host_os_t os);
+
+// Input method for the detected host, or fallback if it has none (unknown
+// host, or macOS where neither method works)
+macro_method_t host_detect_method(macro_method_t fallback);
+
+#endif
@@ -0,0 +1,237 @@
+// Core1 input side - trigger state machine and LED, off the USB core
+
+#include "input.h"
+#include "led.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#define MSG_RING_SIZE 16        // power of two
+#define FIFO_SEQUENCE_DONE 0x444F4E45  // "DONE"
+#define PROGRESS_PERIOD_MS 20          // LED progress refresh while typing
+#define PROGRESS_MIN_LEVEL 24          // LED level at the start of a sequence
+
+static input_config_t const *config;
+
+// Core1 -> core0 messages (single producer, single consumer)
+static input_msg_t msg_ring[MSG_RING_SIZE];
+static volatile uint8_t msg_head = 0;
+static volatile uint8_t msg_tail = 0;
+
+static trigger_state_t state = STATE_IDLE;
+static uint32_t state_start_time = 0;
+static bool sequence_done = false;
+static volatile uint8_t progress = 0;  // from core0
+
+// Flash write handshake (input_park)
+static volatile bool launched = false;
+static volatile bool park_request = false;
+static volatile bool parked = false;
+
+// Runs from RAM - flash may be erased under it
+static void __not_in_flash_func(park)(void) {
+    uint32_t irq = save_and_disable_interrupts();
+    parked = true;
+    __sev();
+    while (park_request) __wfe();
+    parked = false;
+    restore_interrupts(irq);
+}
+
+static void send(input_msg_type_t type, trigger_event_t const *ev) {
+    uint8_t next = (msg_head + 1) & (MSG_RING_SIZE - 1);
+    if (next == msg_tail) return;  // core0 is not keeping up - drop
+
+    input_msg_t *m = &msg_ring[msg_head];
+    m->type = (uint8_t)type;
+    m->state = (uint8_t)state;
+    m->event = *ev;
+    __mem_fence_release();
+    msg_head = next;
+    __sev();  // wake core0
+}
+
+static void send_key(matrix_event_t const *key) {
+    uint8_t next = (msg_head + 1) & (MSG_RING_SIZE - 1);
+    if (next == msg_tail) return;
+
+    input_msg_t *m = &msg_ring[msg_head];
+    m->type = INPUT_MSG_KEY;
+    m->state = (uint8_t)state;
+    m->key = *key;
+    __mem_fence_release();
+    msg_head = next;
+    __sev();
+}
+
+static void set_state(trigger_state_t next, uint32_t now) {
+    trigger_event_t none = {0};
+    state = next;
+    state_start_time = now;
+    send(INPUT_MSG_STATE, &none);
+}
+
+static int pin_index(uint8_t pin) {
+    for (uint8_t i = 0; i < config->pin_count; i++) {
+        if (config->pins[i] == pin) return i;
+    }
+    return -1;
+}
+
+static bool any_pressed(void) {
+    for (uint8_t i = 0; i < config->pin_count; i++) {
+        if (trigger_is_pressed(config->pins[i])) return true;
+    }
+    return false;
+}
+
+static void handle_event(trigger_event_t const *ev, uint32_t now) {
+    if (state == STATE_IDLE && ev->pressed) {
+        // Confirmed press - hand it to core0 so typing starts now, then
+        // blink the mode (pin index + 1 times) while it streams. The LED
+        // brightens with the progress after that.
+        state = STATE_TRIGGERED;
+        state_start_time = now;
+        sequence_done = false;
+        progress = 0;
+        send(INPUT_MSG_TRIGGER, ev);
+
+        int idx = pin_index(ev->pin);
+        led_set(PROGRESS_MIN_LEVEL);
+        led_blink((uint8_t)(idx + 1), (uint16_t)(100 / (idx + 1)));
+        return;
+    }
+    // Presses while triggered or cooling down are ignored
+    send(INPUT_MSG_EVENT, ev);
+}
+
+// Macro pad: scan at a fixed rate and forward every key change. Core0 queues
+// a macro per press, so keys never wait on each other or on the LED.
+static void matrix_main(void) {
+    matrix_init(config->matrix);
+    led_init(config->led_pin);
+
+    absolute_time_t next_scan = get_absolute_time();
+    while (true) {
+        if (park_request) park();
+        matrix_scan();
+
+        matrix_event_t key;
+        while (matrix_pop(&key)) {
+            send_key(&key);
+        }
+        led_set(matrix_any_pressed() ? 255 : 0);
+
+        // Drain "sequence done" words; nothing waits on them here
+        while (multicore_fifo_rvalid()) multicore_fifo_pop_blocking();
+
+        next_scan = delayed_by_us(next_scan, MATRIX_SCAN_PERIOD_US);
+        while (!best_effort_wfe_or_timeout(next_scan)) {}
+    }
+}
+
+static void core1_main(void) {
+    if (config->matrix) matrix_main();
+
+    // The PIO interrupt is enabled from here, so it is serviced on core1
+    uint32_t debounce_us = config->debounce_ms * 1000;
+    trigger_init(config->pins, config->pin_count, debounce_us);
+
+    // Signal ready with LED, without holding up the first trigger
+    led_init(config->led_pin);
+    led_blink(3, 100);
+
+    while (true) {
+        if (park_request) park();
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+
+        while (multicore_fifo_rvalid()) {
+            if (multicore_fifo_pop_blocking() == FIFO_SEQUENCE_DONE) {
+                sequence_done = true;
+                led_set(0);
+            }
+        }
+
+        trigger_event_t ev;
+        while (trigger_pop(&ev)) {
+            handle_event(&ev, now);
+        }
+
+        switch (state) {
+            case STATE_IDLE:
+                break;
+
+            case STATE_TRIGGERED:
+                // Wait for the sequence to drain and for release of every pin
+                if (sequence_done && !any_pressed()) {
+                    set_state(STATE_COOLDOWN, now);
+                }
+                break;
+
+            case STATE_COOLDOWN:
+                if (now - state_start_time >= config->cooldown_ms) {
+                    set_state(STATE_IDLE, now);
+                }
+                break;
+        }
+
+        // Sleep until a trigger event or a FIFO word arrives, the cooldown
+        // runs out or the LED changes
+        absolute_time_t wake = led_task();
+        if (state == STATE_TRIGGERED && !sequence_done) {
+            led_set((uint8_t)(PROGRESS_MIN_LEVEL + progress * (255 - PROGRESS_MIN_LEVEL) / 255));
+            absolute_time_t refresh = make_timeout_time_ms(PROGRESS_PERIOD_MS);
+            if (to_us_since_boot(refresh) < to_us_since_boot(wake)) wake = refresh;
+        }
+        if (state == STATE_COOLDOWN) {
+            absolute_time_t cooldown = make_timeout_time_ms(config->cooldown_ms - (now - state_start_time));
+            if (to_us_since_boot(cooldown) < to_us_since_boot(wake)) wake = cooldown;
+        }
+        best_effort_wfe_or_timeout(wake);
+    }
+}
+
+void input_launch(input_config_t const *cfg) {
+    config = cfg;
+    multicore_launch_core1(core1_main);
+    launched = true;
+}
+
+void input_park(void) {
+    if (!launched) return;
+    park_request = true;
+    __sev();
+    while (!parked) __wfe();
+}
+
+void input_unpark(void) {
+    if (!launched) return;
+    park_request = false;
+    __sev();
+}
+
+bool input_pop(input_msg_t *msg) {
+    if (msg_tail == msg_head) return false;
+    __mem_fence_acquire();
+    *msg = msg_ring[msg_tail];
+    msg_tail = (msg_tail + 1) & (MSG_RING_SIZE - 1);
+    return true;
+}
+
+void input_sequence_done(void) {
+    multicore_fifo_push_blocking(FIFO_SEQUENCE_DONE);
+}
+
+void input_progress(uint8_t p) {
+    progress = p;
+}
+
+const char *input_state_name(trigger_state_t s) {
+    switch (s) {
+        case STATE_IDLE: return "IDLE";
+        case STATE_TRIGGERED: return "TRIGGERED";
+        case STATE_COOLDOWN: return "COOLDOWN";
+        default: return "?";
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "trigger.h"
+#include "matrix.h"
+
+// Core1 input side: trigger capture, the trigger state machine and the LED
+// (led.h).
+// With a key matrix configured, core1 scans it instead and forwards every
+// key press and release; there is no per-key state machine.
+//
+// Core1 owns everything here; core0 only runs USB and the HID sender. Core1
+// reports to core0 through an SPSC ring (input_pop) and core0 answers over
+// the inter-core FIFO when a queued sequence has drained.
+
+typedef enum {
+    STATE_IDLE,        // waiting for a press
+    STATE_TRIGGERED,   // sequence requested, waiting for it to drain and for release
+    STATE_COOLDOWN     // lockout to prevent double-triggers
+} trigger_state_t;
+
+typedef enum {
+    INPUT_MSG_EVENT,    // a debounced press/release (for logging)
+    INPUT_MSG_TRIGGER,  // start the sequence for event.pin now
+    INPUT_MSG_STATE,    // the state machine moved on without an event
+    INPUT_MSG_KEY,      // a debounced matrix key press/release
+} input_msg_type_t;
+
+typedef struct {
+    uint8_t type;            // input_msg_type_t
+    uint8_t state;           // trigger_state_t after handling the event
+    union {
+        trigger_event_t event;  // INPUT_MSG_EVENT, INPUT_MSG_TRIGGER
+        matrix_event_t key;     // INPUT_MSG_KEY
+    };
+} input_msg_t;
+
+typedef struct {
+    uint8_t const *pins;     // trigger pins; blink count = index + 1
+    uint8_t pin_count;
+    uint8_t led_pin;
+    uint32_t debounce_ms;
+    uint32_t cooldown_ms;
+    matrix_config_t const *matrix;  // scan this instead of the trigger pins
+} input_config_t;
+
+// Core0: start core1. cfg must stay valid forever.
+void input_launch(input_config_t const *cfg);
+
+// Core0: next message from core1. Returns false if there is none.
+bool input_pop(input_msg_t *msg);
+
+// Core0: the sequence requested by the last INPUT_MSG_TRIGGER has drained
+void input_sequence_done(void);
+
+// Core0: how far that sequence is (hid_queue_progress()), shown on the LED
+void input_progress(uint8_t progress);
+
+// Core0: stop core1 in a RAM loop with its interrupts off, so flash can be
+// erased and programmed, and let it go again. Core1 parks at the top of
+// its loop, so this can wait up to one scan period.
+// The SDK's multicore_lockout is not used: its handler would swallow the
+// sequence-done FIFO words.
+void input_park(void);
+void input_unpark(void);
+
+const char *input_state_name(trigger_state_t s);
+
+#endif
@@ -0,0 +1,41 @@
+// Keystroke stream optimizer - drops release reports the host does not need
+
+#include "key_stream.h"
+
+void key_stream_init(key_stream_t *ks) {
+    ks->held.modifier = 0;
+    ks->held.keycode = 0;
+    ks->active = false;
+}
+
+uint8_t key_stream_tap(key_stream_t *ks, uint8_t modifier, uint8_t keycode, hid_report_t out[2]) {
+    uint8_t n = 0;
+
+    if (ks->active) {
+        bool same_key = (ks->held.keycode == keycode);
+        bool new_mods = (modifier & ~ks->held.modifier) != 0;
+        if (same_key || new_mods) {
+            // Let go of the key and switch to the next tap's modifiers in
+            // one frame, so they are settled before its key goes down
+            out[n].modifier = modifier;
+            out[n].keycode = 0;
+            n++;
+        }
+    }
+
+    out[n].modifier = modifier;
+    out[n].keycode = keycode;
+    n++;
+
+    ks->held = out[n - 1];
+    ks->active = true;
+    return n;
+}
+
+uint8_t key_stream_end(key_stream_t *ks, hid_report_t out[1]) {
+    if (!ks->active) return 0;
+    out[0].modifier = 0;
+    out[0].keycode = 0;
+    key_stream_init(ks);
+    return 1;
+}
@@ -0,0 +1,29 @@
+#ifndef KEY_STREAM_H
+#define KEY_STREAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hid_queue.h"
+
+// Plans the report stream for a run of key taps.
+//
+// A tap normally needs a press report and an all-zero release report. The
+// release is only needed when the host would otherwise not see a new key
+// going down: when the same keycode repeats ("00b0"), or when the next tap
+// adds a modifier that must be down before its key. Otherwise the next
+// press simply replaces the held key, and a modifier that both taps share
+// stays held across them.
+typedef struct {
+    hid_report_t held;  // last report sent
+    bool active;        // a key from the last tap is still down
+} key_stream_t;
+
+void key_stream_init(key_stream_t *ks);
+
+// Plan one tap. Writes 1-2 reports to out and returns how many.
+uint8_t key_stream_tap(key_stream_t *ks, uint8_t modifier, uint8_t keycode, hid_report_t out[2]);
+
+// Release whatever is still held. Writes 0-1 reports and returns how many.
+uint8_t key_stream_end(key_stream_t *ks, hid_report_t out[1]);
+
+#endif
@@ -0,0 +1,252 @@
+// Keyboard layout tables - ASCII to {modifier, keycode} per host layout
+
+#include <string.h>
+#include "keymap.h"
+
+// HID usage IDs (keyboard page), named after the US key at that position
+#define KEY_A            0x04
+#define KEY_1            0x1E
+#define KEY_0            0x27
+#define KEY_ENTER        0x28
+#define KEY_TAB          0x2B
+#define KEY_SPACE        0x2C
+#define KEY_MINUS        0x2D
+#define KEY_EQUAL        0x2E
+#define KEY_BRACKET_L    0x2F
+#define KEY_BRACKET_R    0x30
+#define KEY_BACKSLASH    0x31
+#define KEY_ISO_HASH     0x32  // ISO: left of Enter
+#define KEY_SEMICOLON    0x33
+#define KEY_APOSTROPHE   0x34
+#define KEY_GRAVE        0x35
+#define KEY_COMMA        0x36
+#define KEY_PERIOD       0x37
+#define KEY_SLASH        0x38
+#define KEY_ISO_BACKSLASH 0x64 // ISO: right of left Shift
+
+#define KEY_LETTER(c)    (KEY_A + ((c) - 'a'))
+#define KEY_DIGIT(d)     ((d) == 0 ? KEY_0 : KEY_1 + (d) - 1)
+
+#define K(code)   { 0, (code) }
+#define S(code)   { KEYMAP_MOD_SHIFT, (code) }
+#define AG(code)  { KEYMAP_MOD_ALTGR, (code) }
+
+// A letter on the key at position p, capital with Shift
+#define LETTER(c, p)  [c] = K(KEY_LETTER(p)), [(c) - 32] = S(KEY_LETTER(p))
+
+// The letters that stay where US has them
+#define LETTERS_COMMON \
+    LETTER('b', 'b'), LETTER('c', 'c'), LETTER('d', 'd'), LETTER('e', 'e'), LETTER('f', 'f'), \
+    LETTER('g', 'g'), LETTER('h', 'h'), LETTER('i', 'i'), LETTER('j', 'j'), LETTER('k', 'k'), \
+    LETTER('l', 'l'), LETTER('n', 'n'), LETTER('o', 'o'), LETTER('p', 'p'), LETTER('r', 'r'), \
+    LETTER('s', 's'), LETTER('t', 't'), LETTER('u', 'u'), LETTER('v', 'v'), LETTER('x', 'x')
+
+#define CONTROLS  ['\t'] = K(KEY_TAB), ['\n'] = K(KEY_ENTER), [' '] = K(KEY_SPACE)
+
+keymap_t const keymaps[KEYMAP_COUNT] = {
+    [KEYMAP_US] = {
+        .keys = {
+            CONTROLS, LETTERS_COMMON,
+            LETTER('a', 'a'), LETTER('m', 'm'), LETTER('q', 'q'),
+            LETTER('w', 'w'), LETTER('y', 'y'), LETTER('z', 'z'),
+            ['1'] = K(KEY_DIGIT(1)), ['2'] = K(KEY_DIGIT(2)), ['3'] = K(KEY_DIGIT(3)),
+            ['4'] = K(KEY_DIGIT(4)), ['5'] = K(KEY_DIGIT(5)), ['6'] = K(KEY_DIGIT(6)),
+            ['7'] = K(KEY_DIGIT(7)), ['8'] = K(KEY_DIGIT(8)), ['9'] = K(KEY_DIGIT(9)),
+            ['0'] = K(KEY_DIGIT(0)),
+            ['!'] = S(KEY_DIGIT(1)), ['@'] = S(KEY_DIGIT(2)), ['#'] = S(KEY_DIGIT(3)),
+            ['$'] = S(KEY_DIGIT(4)), ['%'] = S(KEY_DIGIT(5)), ['^'] = S(KEY_DIGIT(6)),
+            ['&'] = S(KEY_DIGIT(7)), ['*'] = S(KEY_DIGIT(8)), ['('] = S(KEY_DIGIT(9)),
+            [')'] = S(KEY_DIGIT(0)),
+            ['-'] = K(KEY_MINUS),      ['_'] = S(KEY_MINUS),
+            ['='] = K(KEY_EQUAL),      ['+'] = S(KEY_EQUAL),
+            ['['] = K(KEY_BRACKET_L),  ['{'] = S(KEY_BRACKET_L),
+            [']'] = K(KEY_BRACKET_R),  ['}'] = S(KEY_BRACKET_R),
+            ['\\'] = K(KEY_BACKSLASH), ['|'] = S(KEY_BACKSLASH),
+            [';'] = K(KEY_SEMICOLON),  [':'] = S(KEY_SEMICOLON),
+            ['\''] = K(KEY_APOSTROPHE), ['"'] = S(KEY_APOSTROPHE),
+            ['`'] = K(KEY_GRAVE),      ['~'] = S(KEY_GRAVE),
+            [','] = K(KEY_COMMA),      ['<'] = S(KEY_COMMA),
+            ['.'] = K(KEY_PERIOD),     ['>'] = S(KEY_PERIOD),
+            ['/'] = K(KEY_SLASH),      ['?'] = S(KEY_SLASH),
+        },
+        .dead = { "", "" },
+    },
+
+    // German T1: Y and Z swapped, umlauts where US has punctuation
+    [KEYMAP_DE] = {
+        .keys = {
+            CONTROLS, LETTERS_COMMON,
+            LETTER('a', 'a'), LETTER('m', 'm'), LETTER('q', 'q'),
+            LETTER('w', 'w'), LETTER('y', 'z'), LETTER('z', 'y'),
+            ['1'] = K(KEY_DIGIT(1)), ['2'] = K(KEY_DIGIT(2)), ['3'] = K(KEY_DIGIT(3)),
+            ['4'] = K(KEY_DIGIT(4)), ['5'] = K(KEY_DIGIT(5)), ['6'] = K(KEY_DIGIT(6)),
+            ['7'] = K(KEY_DIGIT(7)), ['8'] = K(KEY_DIGIT(8)), ['9'] = K(KEY_DIGIT(9)),
+            ['0'] = K(KEY_DIGIT(0)),
+            ['!'] = S(KEY_DIGIT(1)), ['"'] = S(KEY_DIGIT(2)), ['$'] = S(KEY_DIGIT(4)),
+            ['%'] = S(KEY_DIGIT(5)), ['&'] = S(KEY_DIGIT(6)), ['/'] = S(KEY_DIGIT(7)),
+            ['('] = S(KEY_DIGIT(8)), [')'] = S(KEY_DIGIT(9)), ['='] = S(KEY_DIGIT(0)),
+            ['{'] = AG(KEY_DIGIT(7)), ['['] = AG(KEY_DIGIT(8)), [']'] = AG(KEY_DIGIT(9)),
+            ['}'] = AG(KEY_DIGIT(0)), ['@'] = AG(KEY_LETTER('q')),
+            ['?'] = S(KEY_MINUS),      ['\\'] = AG(KEY_MINUS),     // ß
+            ['`'] = S(KEY_EQUAL),                                  // ´
+            ['+'] = K(KEY_BRACKET_R),  ['*'] = S(KEY_BRACKET_R), ['~'] = AG(KEY_BRACKET_R),
+            ['#'] = K(KEY_ISO_HASH),   ['\''] = S(KEY_ISO_HASH),
+            ['^'] = K(KEY_GRAVE),
+            [','] = K(KEY_COMMA),      [';'] = S(KEY_COMMA),
+            ['.'] = K(KEY_PERIOD),     [':'] = S(KEY_PERIOD),
+            ['-'] = K(KEY_SLASH),      ['_'] = S(KEY_SLASH),
+            ['<'] = K(KEY_ISO_BACKSLASH), ['>'] = S(KEY_ISO_BACKSLASH), ['|'] = AG(KEY_ISO_BACKSLASH),
+        },
+        .dead = { "^`~", "^`" },
+    },
+
+    // French AZERTY: A/Q and Z/W swapped, M right of L, digits with Shift
+    [KEYMAP_FR] = {
+        .keys = {
+            CONTROLS, LETTERS_COMMON,
+            LETTER('a', 'q'), LETTER('q', 'a'), LETTER('w', 'z'), LETTER('z', 'w'), LETTER('y', 'y'),
+            ['m'] = K(KEY_SEMICOLON),  ['M'] = S(KEY_SEMICOLON),
+            ['1'] = S(KEY_DIGIT(1)), ['2'] = S(KEY_DIGIT(2)), ['3'] = S(KEY_DIGIT(3)),
+            ['4'] = S(KEY_DIGIT(4)), ['5'] = S(KEY_DIGIT(5)), ['6'] = S(KEY_DIGIT(6)),
+            ['7'] = S(KEY_DIGIT(7)), ['8'] = S(KEY_DIGIT(8)), ['9'] = S(KEY_DIGIT(9)),
+            ['0'] = S(KEY_DIGIT(0)),
+            ['&'] = K(KEY_DIGIT(1)),   ['~'] = AG(KEY_DIGIT(2)),   // é
+            ['"'] = K(KEY_DIGIT(3)),   ['#'] = AG(KEY_DIGIT(3)),
+            ['\''] = K(KEY_DIGIT(4)),  ['{'] = AG(KEY_DIGIT(4)),
+            ['('] = K(KEY_DIGIT(5)),   ['['] = AG(KEY_DIGIT(5)),
+            ['-'] = K(KEY_DIGIT(6)),   ['|'] = AG(KEY_DIGIT(6)),
+            ['`'] = AG(KEY_DIGIT(7)),                              // è
+            ['_'] = K(KEY_DIGIT(8)),   ['\\'] = AG(KEY_DIGIT(8)),
+            ['^'] = AG(KEY_DIGIT(9)),                              // ç
+            ['@'] = AG(KEY_DIGIT(0)),                              // à
+            [')'] = K(KEY_MINUS),      [']'] = AG(KEY_MINUS),
+            ['='] = K(KEY_EQUAL),      ['+'] = S(KEY_EQUAL),     ['}'] = AG(KEY_EQUAL),
+            ['$'] = K(KEY_BRACKET_R),
+            ['*'] = K(KEY_ISO_HASH),
+            ['%'] = S(KEY_APOSTROPHE),                             // ù
+            [','] = K(KEY_LETTER('m')), ['?'] = S(KEY_LETTER('m')),
+            [';'] = K(KEY_COMMA),      ['.'] = S(KEY_COMMA),
+            [':'] = K(KEY_PERIOD),     ['/'] = S(KEY_PERIOD),
+            ['!'] = K(KEY_SLASH),
+            ['<'] = K(KEY_ISO_BACKSLASH), ['>'] = S(KEY_ISO_BACKSLASH),
+        },
+        // X11 fr has no dead AltGr keys; Windows makes ~ and ` dead
+        .dead = { "", "~`" },
+    },
+};
+
+// What each key types on the host, written out from the layout definitions
+// (X11 symbols) row by row instead of derived from the tables above, so
+// keymap_verify() can check one against the other. Rows follow the keys
+// left to right: the number row from the key left of 1, the three letter
+// rows, and the bottom row from the ISO key left of the US Z. NA is a key
+// that types no ASCII character - a letter with an accent, a symbol, or a
+// dead key for one - and so is every key past the end of a string.
+#define NA "\x7F"
+
+#define ROW_KEYS 13
+
+static uint8_t const rows[4][ROW_KEYS] = {
+    { KEY_GRAVE, KEY_DIGIT(1), KEY_DIGIT(2), KEY_DIGIT(3), KEY_DIGIT(4), KEY_DIGIT(5), KEY_DIGIT(6),
+      KEY_DIGIT(7), KEY_DIGIT(8), KEY_DIGIT(9), KEY_DIGIT(0), KEY_MINUS, KEY_EQUAL },
+    { KEY_LETTER('q'), KEY_LETTER('w'), KEY_LETTER('e'), KEY_LETTER('r'), KEY_LETTER('t'), KEY_LETTER('y'),
+      KEY_LETTER('u'), KEY_LETTER('i'), KEY_LETTER('o'), KEY_LETTER('p'), KEY_BRACKET_L, KEY_BRACKET_R,
+      KEY_BACKSLASH },
+    { KEY_LETTER('a'), KEY_LETTER('s'), KEY_LETTER('d'), KEY_LETTER('f'), KEY_LETTER('g'), KEY_LETTER('h'),
+      KEY_LETTER('j'), KEY_LETTER('k'), KEY_LETTER('l'), KEY_SEMICOLON, KEY_APOSTROPHE, KEY_ISO_HASH },
+    { KEY_ISO_BACKSLASH, KEY_LETTER('z'), KEY_LETTER('x'), KEY_LETTER('c'), KEY_LETTER('v'), KEY_LETTER('b'),
+      KEY_LETTER('n'), KEY_LETTER('m'), KEY_COMMA, KEY_PERIOD, KEY_SLASH },
+};
+
+// Per layout: each row unshifted, with Shift and with AltGr
+typedef struct {
+    char const *plain[4], *shift[4], *altgr[4];
+} keymap_rows_t;
+
+static keymap_rows_t const typed[KEYMAP_COUNT] = {
+    [KEYMAP_US] = {
+        .plain = { "`1234567890-=", "qwertyuiop[]\\", "asdfghjkl;'" NA, NA "zxcvbnm,./" },
+        .shift = { "~!@#$%^&*()_+", "QWERTYUIOP{}|", "ASDFGHJKL:\"" NA, NA "ZXCVBNM<>?" },
+        .altgr = { "", "", "", "" },
+    },
+    [KEYMAP_DE] = {
+        .plain = { "^1234567890" NA NA, "qwertzuiop" NA "+" NA, "asdfghjkl" NA NA "#", "<yxcvbnm,.-" },
+        .shift = { NA "!\"" NA "$%&/()=?`", "QWERTZUIOP" NA "*" NA, "ASDFGHJKL" NA NA "'", ">YXCVBNM;:_" },
+        .altgr = { NA NA NA NA NA NA NA "{[]}\\" NA, "@" NA NA NA NA NA NA NA NA NA NA "~" NA, "", "|" },
+    },
+    [KEYMAP_FR] = {
+        .plain = { NA "&" NA "\"'(-" NA "_" NA NA ")=", "azertyuiop" NA "$" NA, "qsdfghjklm" NA "*",
+                   "<wxcvbn,;:!" },
+        .shift = { NA "1234567890" NA "+", "AZERTYUIOP" NA NA NA, "QSDFGHJKLM%" NA, ">WXCVBN?./" NA },
+        .altgr = { NA NA "~#{[|`\\^@]}", "", "", "" },
+    },
+};
+
+bool keymap_lookup(keymap_layout_t layout, macro_method_t method, char c,
+                   hid_report_t *key, bool *dead) {
+    if (layout >= KEYMAP_COUNT || (unsigned char)c >= 128) return false;
+    *key = keymaps[layout].keys[(unsigned char)c];
+    *dead = c && strchr(keymaps[layout].dead[method], c) != NULL;
+    return key->keycode != 0;
+}
+
+// Fill what[] with the character each {Shift/AltGr level, key} types, from
+// typed[]; false if a row string is longer than its row of keys
+static bool typed_table(keymap_layout_t layout, char what[3][256]) {
+    keymap_rows_t const *t = &typed[layout];
+    char const *const *levels[3] = { t->plain, t->shift, t->altgr };
+
+    memset(what, 0, 3 * 256);
+    for (int level = 0; level < 3; level++) {
+        for (int row = 0; row < 4; row++) {
+            char const *chars = levels[level][row];
+            size_t n = strlen(chars);
+            if (n > ROW_KEYS || (n && rows[row][n - 1] == 0)) return false;
+            for (size_t i = 0; i < n; i++) {
+                if (chars[i] != 0x7F) what[level][rows[row][i]] = chars[i];
+            }
+        }
+    }
+    // The same on every layout
+    what[0][KEY_SPACE] = ' ';
+    what[0][KEY_TAB] = '\t';
+    what[0][KEY_ENTER] = '\n';
+    return true;
+}
+
+int keymap_verify(keymap_layout_t layout) {
+    // Which character each {modifier, keycode} types, 0 = none yet
+    static char owner[256][256];
+    memset(owner, 0, sizeof(owner));
+    static char what[3][256];
+    if (!typed_table(layout, what)) return 0;
+
+    for (int c = 0; c < 128; c++) {
+        if (c < ' ' && c != '\t' && c != '\n') continue;
+        if (c == 0x7F) continue;
+
+        hid_report_t key;
+        bool dead;
+        if (!keymap_lookup(layout, MACRO_METHOD_LINUX, (char)c, &key, &dead)) return c;
+        if (owner[key.modifier][key.keycode]) return c;
+        owner[key.modifier][key.keycode] = (char)c;
+
+        // And back: the layout itself types c on that key
+        int level = key.modifier == 0 ? 0 : key.modifier == KEYMAP_MOD_SHIFT ? 1 :
+                    key.modifier == KEYMAP_MOD_ALTGR ? 2 : -1;
+        if (level < 0 || what[level][key.keycode] != c) return c;
+    }
+    return -1;
+}
+
+char keymap_typed(keymap_layout_t layout, uint8_t modifier, uint8_t keycode) {
+    static char what[KEYMAP_COUNT][3][256];
+    static signed char built[KEYMAP_COUNT];  // 0 = not yet, 1 = ok, -1 = malformed
+    if (layout >= KEYMAP_COUNT) return 0;
+    if (!built[layout]) built[layout] = typed_table(layout, what[layout]) ? 1 : -1;
+    if (built[layout] < 0) return 0;
+
+    int level = modifier == 0 ? 0 : modifier == KEYMAP_MOD_SHIFT ? 1 :
+                modifier == KEYMAP_MOD_ALTGR ? 2 : -1;
+    return level < 0 ? 0 : what[layout][level][keycode];
+}
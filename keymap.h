@@ -0,0 +1,56 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hid_queue.h"
+#include "macro_library.h"
+
+// Keyboard layouts - which key the host's layout puts each ASCII character on
+//
+// One constant 128-entry table of {modifier, keycode} per layout, indexed by
+// the character, so a lookup is one read. lenny_gen compiles every macro
+// through the tables of the layouts it is given, and the firmware picks one
+// of those at run time (macro_library_select_layout()). Characters on dead
+// keys are followed by Space; which keys are dead differs between the X11
+// and Windows versions of a layout, so that depends on the input method.
+// Only the ids and names are needed on the device; the tables are for
+// lenny_gen.
+
+typedef enum {
+    KEYMAP_US,      // US QWERTY
+    KEYMAP_DE,      // German QWERTZ
+    KEYMAP_FR,      // French AZERTY
+    KEYMAP_COUNT
+} keymap_layout_t;
+
+#define KEYMAP_NAMES { "us", "de", "fr" }
+
+#define KEYMAP_MOD_SHIFT 0x02  // left Shift
+#define KEYMAP_MOD_ALTGR 0x40  // right Alt
+
+typedef struct {
+    hid_report_t keys[128];                   // keycode 0 = no key
+    char const *dead[MACRO_METHOD_COUNT];     // characters on dead keys
+} keymap_t;
+
+extern keymap_t const keymaps[KEYMAP_COUNT];
+
+// The key for c, and whether it is dead (needs a Space after it). Returns
+// false for characters the layout has no key for.
+bool keymap_lookup(keymap_layout_t layout, macro_method_t method, char c,
+                   hid_report_t *key, bool *dead);
+
+// Round-trip check: every printable character, Tab and Newline has a key,
+// no two characters share one, and the layout as written out key by key in
+// keymap.c (from its X11 definition, independent of the lookup table)
+// types that character on that key. Returns the first character that
+// fails, 0 for a malformed key-by-key table, or -1.
+int keymap_verify(keymap_layout_t layout);
+
+// The character the layout types on keycode with modifier (none, Shift or
+// AltGr), from the key-by-key table - what a host would see. 0 for keys and
+// modifier combinations that type nothing printable, or a malformed table.
+char keymap_typed(keymap_layout_t layout, uint8_t modifier, uint8_t keycode);
+
+#endif
@@ -0,0 +1,70 @@
+// Latency statistics - per-stage sample windows with min/avg/p99 on demand
+
+#include "latency.h"
+
+static uint32_t samples[LAT_STAGE_COUNT][LATENCY_WINDOW];
+static uint32_t recorded = 0;
+
+bool latency_record(latency_trace_t const *trace) {
+    if (trace->confirm_us < trace->edge_us ||
+        trace->queued_us < trace->confirm_us ||
+        trace->first_ack_us < trace->queued_us ||
+        trace->last_ack_us < trace->first_ack_us) {
+        return false;
+    }
+
+    uint32_t slot = recorded & (LATENCY_WINDOW - 1);
+    samples[LAT_DEBOUNCE][slot]  = (uint32_t)(trace->confirm_us - trace->edge_us);
+    samples[LAT_HANDOFF][slot]   = (uint32_t)(trace->queued_us - trace->confirm_us);
+    samples[LAT_FIRST_KEY][slot] = (uint32_t)(trace->first_ack_us - trace->queued_us);
+    samples[LAT_TYPING][slot]    = (uint32_t)(trace->last_ack_us - trace->first_ack_us);
+    samples[LAT_TOTAL][slot]     = (uint32_t)(trace->last_ack_us - trace->edge_us);
+    recorded++;
+    return true;
+}
+
+void latency_reset(void) {
+    recorded = 0;
+}
+
+uint32_t latency_count(void) {
+    return recorded;
+}
+
+bool latency_stats(latency_stage_t stage, latency_stats_t *out) {
+    uint32_t n = recorded < LATENCY_WINDOW ? recorded : LATENCY_WINDOW;
+    if (stage >= LAT_STAGE_COUNT || n == 0) return false;
+
+    // Insertion sort of a copy - at most 128 samples, only on request
+    static uint32_t sorted[LATENCY_WINDOW];
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t v = samples[stage][i];
+        sum += v;
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    // Nearest-rank percentile: the smallest sample >= 99% of the window
+    uint32_t rank = (n * 99 + 99) / 100;
+    out->min_us = sorted[0];
+    out->avg_us = (uint32_t)(sum / n);
+    out->p99_us = sorted[rank - 1];
+    out->max_us = sorted[n - 1];
+    return true;
+}
+
+const char *latency_stage_name(latency_stage_t stage) {
+    switch (stage) {
+        case LAT_DEBOUNCE:  return "edge->confirm";
+        case LAT_HANDOFF:   return "confirm->queued";
+        case LAT_FIRST_KEY: return "queued->1st ack";
+        case LAT_TYPING:    return "1st->last ack";
+        case LAT_TOTAL:     return "edge->last ack";
+        default:            return "?";
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Trigger-to-keystroke latency statistics for the debug build
+//
+// Every trigger is traced through five timestamps (time_us_64()), which
+// split into the stages below. The last LATENCY_WINDOW samples of each
+// stage are kept so min/avg/p99 can be reported over many presses.
+
+#define LATENCY_WINDOW 128  // samples kept per stage (power of two)
+
+typedef struct {
+    uint64_t edge_us;       // first raw edge of the press
+    uint64_t confirm_us;    // debounce confirmed it
+    uint64_t queued_us;     // macro pushed into hid_queue
+    uint64_t first_ack_us;  // host acknowledged the first report
+    uint64_t last_ack_us;   // host acknowledged the last report
+} latency_trace_t;
+
+typedef enum {
+    LAT_DEBOUNCE,    // edge -> confirm
+    LAT_HANDOFF,     // confirm -> queued (core1 -> core0)
+    LAT_FIRST_KEY,   // queued -> first report acknowledged
+    LAT_TYPING,      // first -> last report acknowledged
+    LAT_TOTAL,       // edge -> last report acknowledged
+    LAT_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+    uint32_t min_us;
+    uint32_t avg_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} latency_stats_t;
+
+// Add one trace. Returns false (and records nothing) if its timestamps are
+// out of order, e.g. a sequence whose acknowledgements were never seen.
+bool latency_record(latency_trace_t const *trace);
+
+void latency_reset(void);
+
+// Traces recorded since the last reset (may exceed LATENCY_WINDOW)
+uint32_t latency_count(void);
+
+// Statistics over the current window. Returns false if it is empty.
+bool latency_stats(latency_stage_t stage, latency_stats_t *out);
+
+const char *latency_stage_name(latency_stage_t stage);
+
+#endif
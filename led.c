@@ -0,0 +1,72 @@
+// LED pattern engine - PWM brightness, no sleeping
+
+#include "led.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+
+#define LED_WRAP (255 * 255)  // level squared: a rough gamma of 2
+
+static uint8_t led_pin;
+static led_step_t steps[LED_MAX_STEPS];
+static uint8_t step_count = 0;
+static uint8_t step = 0;             // step playing, step_count when done
+static absolute_time_t step_end;
+static uint8_t base_level = 0;
+static uint8_t shown = 0;
+
+static void show(uint8_t level) {
+    if (level == shown) return;
+    shown = level;
+    pwm_set_gpio_level(led_pin, (uint16_t)(level * level));
+}
+
+void led_init(uint8_t pin) {
+    led_pin = pin;
+    gpio_set_function(pin, GPIO_FUNC_PWM);
+    uint slice = pwm_gpio_to_slice_num(pin);
+    pwm_set_wrap(slice, LED_WRAP);
+    pwm_set_gpio_level(pin, 0);
+    pwm_set_enabled(slice, true);
+    shown = 0;
+    step = step_count = 0;
+}
+
+void led_play(led_step_t const *s, uint8_t count) {
+    if (count > LED_MAX_STEPS) count = LED_MAX_STEPS;
+    for (uint8_t i = 0; i < count; i++) steps[i] = s[i];
+    step_count = count;
+    step = 0;
+    if (count) {
+        step_end = make_timeout_time_ms(steps[0].ms);
+        show(steps[0].level);
+    } else {
+        show(base_level);
+    }
+}
+
+void led_blink(uint8_t times, uint16_t ms) {
+    led_step_t s[LED_MAX_STEPS];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < times && n + 2 <= LED_MAX_STEPS; i++) {
+        s[n++] = (led_step_t){ 255, ms };
+        if (i < times - 1) s[n++] = (led_step_t){ 0, ms };
+    }
+    led_play(s, n);
+}
+
+void led_set(uint8_t level) {
+    base_level = level;
+    if (step >= step_count) show(level);
+}
+
+absolute_time_t led_task(void) {
+    if (step >= step_count) return at_the_end_of_time;
+
+    absolute_time_t now = get_absolute_time();
+    while (step < step_count && absolute_time_diff_us(step_end, now) >= 0) {
+        if (++step < step_count) step_end = delayed_by_ms(step_end, steps[step].ms);
+    }
+    show(step < step_count ? steps[step].level : base_level);
+    return step < step_count ? step_end : at_the_end_of_time;
+}
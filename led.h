@@ -0,0 +1,40 @@
+#ifndef LED_H
+#define LED_H
+
+#include <stdint.h>
+#include "pico/time.h"
+
+// LED pattern engine - brightness on a PWM slice, stepped from the core1 loop
+//
+// A pattern is a list of {level, ms} steps played once over a base level.
+// Nothing here waits: led_task() applies whatever is due and returns when
+// the LED next changes, which the caller folds into its own sleep. The base
+// level shows when no pattern plays - the trigger firmwares use it for
+// sequence progress, the macro pad for "a key is down". Levels are 0-255
+// and gamma corrected. Core1 only.
+
+typedef struct {
+    uint8_t level;
+    uint16_t ms;
+} led_step_t;
+
+#define LED_MAX_STEPS 16
+
+// Configure pin for PWM, off
+void led_init(uint8_t pin);
+
+// Start playing steps (copied, up to LED_MAX_STEPS), replacing any pattern
+// still playing
+void led_play(led_step_t const *steps, uint8_t count);
+
+// Blink times at full brightness, ms on and ms off
+void led_blink(uint8_t times, uint16_t ms);
+
+// Level shown when no pattern plays
+void led_set(uint8_t level);
+
+// Advance the pattern. Returns when it next needs to run, or
+// at_the_end_of_time while none plays.
+absolute_time_t led_task(void);
+
+#endif
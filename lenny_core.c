@@ -0,0 +1,331 @@
+// Shared core0 firmware - trigger messages in, macros out, scheduler tasks in between
+
+#include "lenny_core.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "tusb.h"
+#include "hid_queue.h"
+#include "power.h"
+#include "perf.h"
+#include "host_detect.h"
+#include "macro_upload.h"
+#include "config_store.h"
+#include "sched.h"
+#include "trace.h"
+#include "lenny_macros.h"
+#if CFG_TUD_CDC
+#include "companion.h"
+#endif
+
+static input_config_t input;  // lenny_config.input with the stored overrides
+static uint16_t selected_macro = MACRO_ID_LENNY;
+static bool sequence_pending = false;
+static int held_pin = -1;  // trigger that arrived while the bus was suspended
+#if CFG_TUD_CDC
+static int offered_pin = -1;  // trigger whose text is offered to the companion daemon
+#else
+#define offered_pin (-1)      // no CDC port, nothing is ever offered
+#endif
+#if LENNY_TRACE_LEVEL >= 2
+static trigger_state_t state = STATE_IDLE;
+#endif
+static uint32_t burst_ms;
+static int burst_pin = -1;    // trigger that may repeat, or is repeating
+static bool bursting = false;     // keeping the queue topped up
+static bool burst_draining = false;  // released, the last faces still sending
+static uint32_t burst_base;    // hid_queue_slots_done() before the burst's first face
+static uint64_t burst_start;
+
+static void start_step(void);
+static void input_step(void);
+static void typing_step(void);
+static void burst_step(void);
+static sched_task_t start_task = { .run = start_step, .name = "start" };
+static sched_task_t input_task = { .run = input_step, .name = "input", .on_wake = true };
+static sched_task_t typing_task = { .run = typing_step, .name = "typing", .on_wake = true };
+static sched_task_t burst_task = { .run = burst_step, .name = "burst" };
+#if LENNY_TRACE_LEVEL >= 2
+static void log_step(void);
+static sched_task_t log_task = { .run = log_step, .name = "log", .on_idle = true };
+#endif
+
+// Stored settings over the image's defaults. Core1 reads the cooldown live;
+// the debounce time only takes effect at the next start.
+static void apply_config(void) {
+    input.debounce_ms = config_store_get(CONFIG_DEBOUNCE_MS, lenny_config.input.debounce_ms);
+    input.cooldown_ms = config_store_get(CONFIG_COOLDOWN_MS, lenny_config.input.cooldown_ms);
+    hid_queue_set_min_gap_us(config_store_get(CONFIG_MIN_GAP_US, HID_PACING_MIN_GAP_US));
+
+    // An id the library does not have (a smaller one was uploaded) falls
+    // back to the default
+    uint32_t macro = config_store_get(CONFIG_MACRO, MACRO_ID_LENNY);
+    selected_macro = macro < macro_library_count() ? (uint16_t)macro : MACRO_ID_LENNY;
+
+    macro_library_select_layout((uint8_t)config_store_get(CONFIG_LAYOUT, MACRO_LIB_DEFAULT_LAYOUT));
+    burst_ms = config_store_get(CONFIG_BURST_MS, lenny_config.burst_ms);
+}
+
+static void config_changed(config_key_t key) {
+    (void)key;
+    apply_config();
+}
+
+void lenny_core_init(void) {
+    input = lenny_config.input;
+
+    power_init();
+    tusb_init();
+    hid_queue_init();
+    macro_upload_init(lenny_library, apply_config);
+    config_store_init(config_changed);
+    apply_config();
+
+    // Ground reference for the trigger pins
+    gpio_init(lenny_config.ground_pin);
+    gpio_set_dir(lenny_config.ground_pin, GPIO_OUT);
+    gpio_put(lenny_config.ground_pin, 0);
+
+    sched_add(&start_task);
+    sched_add(&input_task);
+    sched_add(&typing_task);
+    sched_add(&burst_task);
+#if LENNY_TRACE_LEVEL >= 2
+    sched_add(&log_task);
+#endif
+}
+
+// Core1 starts once the host has enumerated us
+static void start_step(void) {
+    static bool launched = false;
+    if (launched) return;
+    input_launch(&input);
+    launched = true;
+}
+
+void lenny_core_mounted(void) {
+    sched_post(&start_task);
+}
+
+// Trigger pin i types input method i: Linux, then Windows
+static macro_method_t method_for_pin(uint8_t pin) {
+    macro_method_t method = MACRO_METHOD_LINUX;
+    for (uint8_t i = 0; i < lenny_config.input.pin_count && i < MACRO_METHOD_COUNT; i++) {
+        if (lenny_config.input.pins[i] == pin) method = (macro_method_t)i;
+    }
+    // The pin only decides when enumeration did not identify the host
+    return lenny_config.detect_host ? host_detect_method(method) : method;
+}
+
+static bool type_sequence(uint8_t pin) {
+    macro_method_t method = method_for_pin(pin);
+    if (!macro_library_type(selected_macro, method)) {
+        TRACE_LOG("ERROR: macro %u not queued!\r\n", selected_macro);
+        return false;
+    }
+    TRACE_QUEUED(selected_macro, method);
+    return true;
+}
+
+// Start a sequence for a trigger pin - through the companion daemon if one
+// is listening, typed otherwise. Returns false if nothing was started.
+static bool start_sequence(uint8_t pin) {
+    if (!tud_hid_ready() || hid_queue_busy()) {
+        TRACE_LOG("ERROR: HID not ready or previous sequence still sending!\r\n");
+        return false;
+    }
+
+    power_run();
+#if CFG_TUD_CDC
+    if (lenny_config.companion && companion_offer(selected_macro)) {
+        offered_pin = pin;
+        return true;
+    }
+#endif
+    return type_sequence(pin);
+}
+
+#if CFG_TUD_CDC
+// Finish the handshake: the daemon took the text, or it gets typed after all
+static void companion_step(void) {
+    companion_result_t r = companion_task();
+    if (r == COMPANION_WAITING) return;
+
+    if (r == COMPANION_DELIVERED) {
+        TRACE_LOG("COMPANION: macro %u sent as text\r\n", selected_macro);
+        sequence_pending = false;
+        input_sequence_done();
+    } else {
+        TRACE_LOG("COMPANION: not delivered within %u ms, typing\r\n", COMPANION_TIMEOUT_MS);
+        if (!type_sequence((uint8_t)offered_pin)) {
+            sequence_pending = false;
+            input_sequence_done();
+        }
+    }
+    offered_pin = -1;
+}
+#endif
+
+static void handle_trigger(trigger_event_t const *ev) {
+    TRACE_PRESS(ev);
+
+    // Suspended: wake the host and type once it resumes us
+    if (power_suspended()) {
+        if (power_remote_wakeup_allowed() && tud_remote_wakeup()) {
+            TRACE_LOG("WAKE: remote wakeup, typing after resume\r\n");
+            held_pin = ev->pin;
+        } else {
+            input_sequence_done();
+        }
+        return;
+    }
+
+    if (start_sequence(ev->pin)) {
+        sequence_pending = true;
+        // Typed, not offered: repeat if still held after burst_ms
+        if (burst_ms && offered_pin < 0) {
+            burst_pin = ev->pin;
+            sched_at(&burst_task, make_timeout_time_ms(burst_ms));
+        }
+    } else {
+        input_sequence_done();  // nothing to wait for
+    }
+}
+
+// Messages from core1, and a trigger held over a bus suspend
+static void input_step(void) {
+    input_msg_t msg;
+    while (input_pop(&msg)) {
+#if LENNY_TRACE_LEVEL >= 2
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+        if (msg.type == INPUT_MSG_EVENT || msg.type == INPUT_MSG_TRIGGER) {
+            TRACE_LOG("[%lu] EDGE: gpio=%d %s (settled %lu us after first edge)\r\n",
+                      now, msg.event.pin, msg.event.pressed ? "pressed" : "released",
+                      (uint32_t)(msg.event.confirm_us - msg.event.first_edge_us));
+        }
+        if (msg.type == INPUT_MSG_EVENT && msg.state == STATE_COOLDOWN && msg.event.pressed) {
+            TRACE_LOG("[%lu] IGNORED (cooldown)\r\n", now);
+        }
+        if (msg.state != state) TRACE_LOG("[%lu] -> %s\r\n", now, input_state_name(msg.state));
+        state = msg.state;
+#endif
+        if (msg.type == INPUT_MSG_TRIGGER) handle_trigger(&msg.event);
+
+        // Let go before burst_ms - no repeat, even if pressed again in time
+        if (msg.type == INPUT_MSG_EVENT && !msg.event.pressed && msg.event.pin == burst_pin && !bursting) {
+            burst_pin = -1;
+            sched_cancel(&burst_task);
+        }
+    }
+
+    if (held_pin >= 0 && !tud_mounted()) {
+        held_pin = -1;
+        input_sequence_done();
+    } else if (held_pin >= 0 && !power_suspended() && tud_hid_ready()) {
+        if (start_sequence((uint8_t)held_pin)) {
+            sequence_pending = true;
+        } else {
+            input_sequence_done();
+        }
+        held_pin = -1;
+    }
+}
+
+// The trigger is still held burst_ms after it fired
+static void burst_step(void) {
+    if (burst_pin < 0 || !trigger_is_pressed((uint8_t)burst_pin)) {
+        burst_pin = -1;
+        return;
+    }
+    TRACE_LOG("BURST: gpio=%d held, repeating macro %u\r\n", burst_pin, selected_macro);
+    bursting = true;
+    // Faces are counted as the host finishes them, so skip whatever the
+    // trigger itself still has in the queue
+    burst_base = hid_queue_slots_done() + hid_queue_pending();
+    burst_start = time_us_64();
+    sched_post(&typing_task);
+}
+
+// Keep LENNY_BURST_DEPTH faces queued until the trigger is released or
+// the host goes away. Not traced: the latency record is the trigger's.
+static void burst_fill(void) {
+    if (!trigger_is_pressed((uint8_t)burst_pin) || !tud_mounted() || power_suspended()) {
+        bursting = false;
+        burst_draining = true;
+        burst_pin = -1;
+        return;
+    }
+    macro_method_t method = method_for_pin((uint8_t)burst_pin);
+    while (hid_queue_pending() < LENNY_BURST_DEPTH) {
+        if (!macro_library_type(selected_macro, method)) break;
+    }
+}
+
+// Faces the host acknowledged in full, and the time from the burst start to
+// the last acknowledged report. Faces thrown away when the host went away
+// never complete, so they are not counted.
+static void burst_end(void) {
+    burst_draining = false;
+    uint32_t done = hid_queue_slots_done();
+    uint32_t faces = done > burst_base ? done - burst_base : 0;
+    uint64_t end = hid_queue_last_ack_time();
+    // Nothing acknowledged (the host went away first) - no rate
+    uint32_t us = faces && end > burst_start ? (uint32_t)(end - burst_start) : 0;
+#if LENNY_TRACE_LEVEL >= 2
+    uint32_t tenths = us ? (uint32_t)((uint64_t)faces * 10000000u / us) : 0;
+    TRACE_LOG("BURST: %lu faces in %lu ms, %lu.%lu faces/s\r\n",
+              faces, us / 1000, tenths / 10, tenths % 10);
+#endif
+    perf_burst(faces, us);
+}
+
+// The report queue, the companion handshake and the end of a sequence.
+// Yields rather than letting the scheduler sleep while a sequence drains
+// or the companion daemon is being asked, so USB is serviced flat out.
+static void typing_step(void) {
+    if (bursting) burst_fill();
+    hid_queue_task();
+
+#if CFG_TUD_CDC
+    if (offered_pin >= 0) companion_step();
+#endif
+
+    if (sequence_pending && offered_pin < 0) input_progress(hid_queue_progress());
+
+    if (burst_draining && !hid_queue_busy()) burst_end();
+
+    // A burst that started while the trigger's own face was still sending
+    // holds back the done until its last face is out
+    if (sequence_pending && offered_pin < 0 && !bursting && !hid_queue_busy()) {
+        sequence_pending = false;
+        TRACE_SEQUENCE_DONE();
+        input_sequence_done();
+    }
+
+    if (lenny_core_busy()) sched_post(&typing_task);
+}
+
+#if LENNY_TRACE_LEVEL >= 2
+// Log output only goes out once a sequence is done; stays awake until the
+// CDC FIFO has taken all of it
+static void log_step(void) {
+    if (!lenny_core_busy() && TRACE_FLUSH()) sched_post(&log_task);
+}
+#endif
+
+bool lenny_core_busy(void) {
+    return hid_queue_busy() || offered_pin >= 0 || bursting;
+}
+
+#if LENNY_TRACE_LEVEL >= 2
+void lenny_core_select_macro(uint16_t id) {
+    selected_macro = id;
+}
+
+uint16_t lenny_core_macro(void) {
+    return selected_macro;
+}
+
+trigger_state_t lenny_core_state(void) {
+    return state;
+}
+#endif
@@ -0,0 +1,63 @@
+#ifndef LENNY_CORE_H
+#define LENNY_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "input.h"
+#include "macro_library.h"
+#include "trace.h"
+
+// Core0 firmware shared by lenny_keyboard and lenny_debug
+//
+// Owns start-up and the core0 scheduler tasks (sched.h): trigger messages
+// from core1 become macros queued from the flash library, remote wakeup
+// while the bus is suspended, and telling core1 when a sequence has
+// drained. Images add their own descriptors and, for debug, CDC command
+// tasks around it, then hand core0 to sched_run(). The
+// instrumentation compiled in is chosen by LENNY_TRACE_LEVEL (trace.h), so
+// every image runs this same code.
+
+typedef struct {
+    input_config_t input;                 // trigger pins (pin i types macro_method_t i), LED and timing
+    bool detect_host;                     // prefer the method for the detected host OS
+    bool companion;                       // send text to the companion daemon (CDC images only)
+    uint32_t burst_ms;                    // hold time before the macro repeats (0 = never)
+    uint8_t ground_pin;                   // driven low; the triggers short to it
+} lenny_config_t;
+
+// Defined by the image. A constant read in place, so the core keeps no
+// pointer to it.
+extern const lenny_config_t lenny_config;
+
+// Bring up clocks, USB, the report queue, the macro library and the stored
+// settings (config_store.h, which override lenny_config's timing), and add
+// the core tasks to the scheduler. Core1 is launched once the host mounts us.
+void lenny_core_init(void);
+
+// Call from tud_mount_cb()
+void lenny_core_mounted(void);
+
+// True while a sequence is queued, sending or being offered to the
+// companion daemon
+bool lenny_core_busy(void);
+
+// Hold-to-repeat: a trigger still held burst_ms after it fired types the
+// macro again and again, back to back, until it is released. The next
+// face is queued while the current one is still sending (two in the
+// queue), so there is no gap between them and the rate is whatever the
+// report pacing sustains. Core1 is not involved - its state machine still
+// waits for the release and then cools down. A face that went to the
+// companion daemon does not repeat. Finished bursts are counted in the
+// perf report (faces and time, so faces/s).
+#define LENNY_BURST_DEPTH 2
+
+#if LENNY_TRACE_LEVEL >= 2
+// For the debug image's commands and status: the macro typed on trigger
+// (default MACRO_ID_LENNY, or the stored setting), and the latest state
+// reported by the core1 state machine
+void lenny_core_select_macro(uint16_t id);
+uint16_t lenny_core_macro(void);
+trigger_state_t lenny_core_state(void);
+#endif
+
+#endif
@@ -1,19 +1,37 @@
 // Lenny Face Keyboard - DEBUG VERSION with CDC serial output
 // Types ( ͡° ͜ʖ ͡°) via GPIO trigger
 
-#include <stdio.h>
 #include "pico/stdlib.h"
-#include "hardware/gpio.h"
 #include "tusb.h"
-
-#define GPIO_TRIGGER_IN  5
-#define GPIO_TRIGGER_OUT 4
-#define GPIO_LED         25  // Pico onboard LED
+#include "hid_queue.h"
+#include "matrix.h"
+#include "power.h"
+#include "perf.h"
+#include "host_detect.h"
+#include "macro_upload.h"
+#include "config_store.h"
+#include "keymap.h"
+#include "companion.h"
+#include "latency.h"
+#include "sched.h"
+#include "trace.h"
+#include "lenny_core.h"
+
+#if LENNY_TRACE_LEVEL < 2
+#error "lenny_debug prints through the trace log - build it with LENNY_TRACE_LEVEL=2"
+#endif
+
+// Same pins and timing as lenny_keyboard - this image runs the production
+// core (lenny_core.c) with LENNY_TRACE_LEVEL 2
+#define GPIO_TRIGGER_OUT      4    // Ground reference
+#define GPIO_TRIGGER_LINUX    5    // Short to GPIO 4 for Linux mode
+#define GPIO_TRIGGER_WINDOWS  6    // Short to GPIO 4 for Windows mode
+#define GPIO_LED              25   // Pico onboard LED
 
 // Debounce settings
-#define DEBOUNCE_SAMPLES     8     // More samples for reliability
-#define DEBOUNCE_INTERVAL_MS 10    // Longer interval
-#define TRIGGER_COOLDOWN_MS  1000  // Longer cooldown
+#define DEBOUNCE_MS          80    // Pin must be quiet this long after its last edge
+#define TRIGGER_COOLDOWN_MS  1000  // Minimum time between triggers
+#define BURST_HOLD_MS        500   // Held this long, the trigger repeats the face
 
 #define USB_VID 0xCafe
 #define USB_PID 0x4004  // Different PID for debug version
@@ -40,33 +58,41 @@ tusb_desc_device_t const desc_device = {
 };
 
 uint8_t const *tud_descriptor_device_cb(void) {
+    host_detect_descriptor(TUSB_DESC_DEVICE, 0);
     return (uint8_t const *)&desc_device;
 }
 
-// HID Report Descriptor
-uint8_t const desc_hid_report[] = { TUD_HID_REPORT_DESC_KEYBOARD() };
+// HID Report Descriptor - NKRO keyboard (boot-capable, see hid_queue.h) plus
+// the perf counters feature report
+uint8_t const desc_hid_report[] = { HID_QUEUE_REPORT_DESC_KEYBOARD(PERF_HID_REPORT_DESC_FEATURE) };
+
+// Vendor interface for macro uploads (macro_upload.h)
+uint8_t const desc_upload_report[] = { MACRO_UPLOAD_REPORT_DESC };
 
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance) {
-    (void)instance;
-    return desc_hid_report;
+    host_detect_descriptor(HID_DESC_TYPE_REPORT, instance);
+    return instance == MACRO_UPLOAD_INSTANCE ? desc_upload_report : desc_hid_report;
 }
 
 // Configuration descriptor - CDC + HID
-enum { ITF_NUM_CDC = 0, ITF_NUM_CDC_DATA, ITF_NUM_HID, ITF_NUM_TOTAL };
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN)
+enum { ITF_NUM_CDC = 0, ITF_NUM_CDC_DATA, ITF_NUM_HID, ITF_NUM_UPLOAD, ITF_NUM_TOTAL };
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
 #define EPNUM_CDC_NOTIF   0x81
 #define EPNUM_CDC_OUT     0x02
 #define EPNUM_CDC_IN      0x82
 #define EPNUM_HID         0x83
+#define EPNUM_UPLOAD_OUT  0x04
+#define EPNUM_UPLOAD_IN   0x84
 
 uint8_t const desc_configuration[] = {
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, 16, 10)
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, 16, 1),
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_UPLOAD, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_upload_report), EPNUM_UPLOAD_OUT, EPNUM_UPLOAD_IN, MACRO_UPLOAD_REPORT_SIZE, 1)
 };
 
 uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
-    (void)index;
+    host_detect_descriptor(TUSB_DESC_CONFIGURATION, index);
     return desc_configuration;
 }
 
@@ -85,6 +111,7 @@ static uint16_t _desc_str[32];
 uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
     (void)langid;
     size_t chr_count;
+    host_detect_descriptor(TUSB_DESC_STRING, index);
     if (index == 0) {
         memcpy(&_desc_str[1], string_desc_arr[0], 2);
         chr_count = 1;
@@ -101,191 +128,129 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 
 // TinyUSB callbacks
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize) {
-    (void)instance; (void)report_id; (void)report_type; (void)buffer; (void)bufsize;
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE) macro_upload_receive(buffer, bufsize);
+    else if (report_type == HID_REPORT_TYPE_OUTPUT) host_detect_led_report();
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen) {
-    (void)instance; (void)report_id; (void)report_type; (void)buffer; (void)reqlen;
-    return 0;
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE || report_type != HID_REPORT_TYPE_FEATURE) return 0;
+    return perf_get_report(buffer, reqlen);
 }
 
-//--------------------------------------------------------------------+
-// Debug print via CDC
-//--------------------------------------------------------------------+
-
-void dbg_print(const char* str) {
-    if (tud_cdc_connected()) {
-        tud_cdc_write_str(str);
-        tud_cdc_write_flush();
-    }
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
+    (void)report; (void)len;
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_report_complete();
 }
 
-void dbg_printf(const char* fmt, ...) {
-    if (tud_cdc_connected()) {
-        char buf[128];
-        va_list args;
-        va_start(args, fmt);
-        vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        tud_cdc_write_str(buf);
-        tud_cdc_write_flush();
-    }
+// Boot protocol - one key per report until the host goes away
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol) {
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_set_boot_protocol(protocol == HID_PROTOCOL_BOOT);
 }
 
-//--------------------------------------------------------------------+
-// Keyboard Functions
-//--------------------------------------------------------------------+
+// The companion daemon opens the port at COMPANION_BAUD
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding) {
+    (void)itf;
+    companion_line_coding(p_line_coding->bit_rate);
+    TRACE_LOG("COMPANION: %s\r\n", companion_present() ? "daemon attached" : "not attached");
+}
 
-void press_key(uint8_t modifier, uint8_t keycode) {
-    if (!tud_hid_ready()) {
-        dbg_print("  [HID not ready!]\r\n");
-        return;
-    }
-    uint8_t keys[6] = {keycode, 0, 0, 0, 0, 0};
-    tud_hid_keyboard_report(0, modifier, keys);
-    dbg_printf("  KEY: mod=0x%02X key=0x%02X\r\n", modifier, keycode);
-    sleep_ms(25);
-    tud_task();
+void tud_mount_cb(void) {
+    lenny_core_mounted();
 }
 
-void release_keys(void) {
-    if (!tud_hid_ready()) return;
-    uint8_t keys[6] = {0};
-    tud_hid_keyboard_report(0, 0, keys);
-    sleep_ms(25);
-    tud_task();
+void tud_umount_cb(void) {
+    host_detect_reset();
 }
 
-void type_key(uint8_t modifier, uint8_t keycode) {
-    press_key(modifier, keycode);
-    release_keys();
+void tud_suspend_cb(bool remote_wakeup_en) {
+    power_suspend(remote_wakeup_en);
 }
 
-void type_char(char c) {
-    uint8_t keycode = 0, modifier = 0;
-    if (c >= 'a' && c <= 'z') {
-        keycode = HID_KEY_A + (c - 'a');
-    } else if (c >= 'A' && c <= 'Z') {
-        keycode = HID_KEY_A + (c - 'A');
-        modifier = KEYBOARD_MODIFIER_LEFTSHIFT;
-    } else if (c >= '1' && c <= '9') {
-        keycode = HID_KEY_1 + (c - '1');
-    } else if (c == '0') {
-        keycode = HID_KEY_0;
-    } else {
-        switch (c) {
-            case ' ': keycode = HID_KEY_SPACE; break;
-            case '(': keycode = HID_KEY_9; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case ')': keycode = HID_KEY_0; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case '_': keycode = HID_KEY_MINUS; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case '^': keycode = HID_KEY_6; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            default: return;
-        }
-    }
-    dbg_printf("CHAR '%c'\r\n", c);
-    type_key(modifier, keycode);
+void tud_resume_cb(void) {
+    power_resume();
 }
 
-void type_unicode_linux(uint16_t codepoint) {
-    dbg_printf("UNICODE 0x%04X\r\n", codepoint);
-    
-    // Press Ctrl+Shift+U
-    uint8_t keys[6] = {HID_KEY_U, 0, 0, 0, 0, 0};
-    tud_hid_keyboard_report(0, KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT, keys);
-    sleep_ms(40);
-    tud_task();
-    release_keys();
-    sleep_ms(40);
-
-    // Type hex digits
-    char hex[5];
-    snprintf(hex, sizeof(hex), "%04x", codepoint);
-    for (int i = 0; i < 4; i++) {
-        char c = hex[i];
-        uint8_t keycode;
-        if (c >= '0' && c <= '9') {
-            keycode = (c == '0') ? HID_KEY_0 : HID_KEY_1 + (c - '1');
-        } else {
-            keycode = HID_KEY_A + (c - 'a');
-        }
-        type_key(0, keycode);
-    }
+//--------------------------------------------------------------------+
+// Matrix Scan Benchmark
+//--------------------------------------------------------------------+
 
-    // Press Space to confirm
-    type_key(0, HID_KEY_SPACE);
-}
+// Times the real scanner on spare pins (rows GPIO 7-14, columns GPIO 15-22)
+// at 16, 32 and 64 keys; nothing needs to be wired up
+#define BENCH_SCANS 1000
 
-void type_lenny_face(void) {
-    dbg_print("\r\n=== TYPING LENNY FACE ===\r\n");
-    
-    if (!tud_hid_ready()) {
-        dbg_print("ERROR: HID not ready!\r\n");
-        return;
-    }
+static void matrix_benchmark(void) {
+    static const uint8_t rows[MATRIX_MAX_ROWS] = { 7, 8, 9, 10, 11, 12, 13, 14 };
+    static const uint8_t sizes[][2] = { {4, 4}, {4, 8}, {8, 8} };
+
+    power_run();
+    for (uint8_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        matrix_config_t cfg = { rows, sizes[i][0], 15, sizes[i][1] };
+        matrix_init(&cfg);
 
-    type_char('(');
-    type_char(' ');
-    type_unicode_linux(0x0361);
-    type_unicode_linux(0x00b0);
-    type_char(' ');
-    type_unicode_linux(0x035c);
-    type_unicode_linux(0x0296);
-    type_char(' ');
-    type_unicode_linux(0x0361);
-    type_unicode_linux(0x00b0);
-    type_char(' ');
-    type_char(')');
-    
-    dbg_print("=== DONE ===\r\n\r\n");
+        uint64_t start = time_us_64();
+        for (uint32_t n = 0; n < BENCH_SCANS; n++) matrix_scan();
+        uint32_t ns = (uint32_t)((time_us_64() - start) * 1000 / BENCH_SCANS);
+
+        TRACE_LOG("BENCH: %2u keys (%ux%u): %lu ns/scan, max %lu us (%lu.%lu%% of 1 kHz)\r\n",
+                  matrix_key_count(), sizes[i][0], sizes[i][1], ns, matrix_scan_us_max(),
+                  ns / 10000, (ns / 1000) % 10);
+    }
 }
 
 //--------------------------------------------------------------------+
-// Debounce State Machine
+// Serial Commands
 //--------------------------------------------------------------------+
 
-typedef enum {
-    STATE_IDLE,
-    STATE_DEBOUNCING,
-    STATE_TRIGGERED,
-    STATE_COOLDOWN
-} trigger_state_t;
-
-static trigger_state_t state = STATE_IDLE;
-static uint32_t state_start_time = 0;
-static uint8_t debounce_count = 0;
-
-const char* state_name(trigger_state_t s) {
-    switch(s) {
-        case STATE_IDLE: return "IDLE";
-        case STATE_DEBOUNCING: return "DEBOUNCING";
-        case STATE_TRIGGERED: return "TRIGGERED";
-        case STATE_COOLDOWN: return "COOLDOWN";
-        default: return "?";
+static void print_config(void) {
+    static char const *const names[] = CONFIG_KEY_NAMES;
+    TRACE_LOG("CONFIG: sector %u, sequence %lu, %u records free\r\n",
+              config_store_sector(), config_store_sequence(), config_store_free());
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (config_store_is_set((config_key_t)key)) {
+            TRACE_LOG("CONFIG: %s = %lu\r\n", names[key], config_store_get((config_key_t)key, 0));
+        } else {
+            TRACE_LOG("CONFIG: %s not set\r\n", names[key]);
+        }
     }
-}
 
-// Read raw GPIO value (no processing)
-bool read_gpio_raw(void) {
-    return gpio_get(GPIO_TRIGGER_IN) == 0;
+    static char const *const layouts[] = KEYMAP_NAMES;
+    uint8_t layout = macro_library_layout();
+    TRACE_LOG("CONFIG: typing for layout %s\r\n", layout < KEYMAP_COUNT ? layouts[layout] : "?");
 }
 
-// Read GPIO with multiple samples
-bool read_trigger_stable(void) {
-    int low_count = 0;
-    for (int i = 0; i < 5; i++) {
-        if (gpio_get(GPIO_TRIGGER_IN) == 0) low_count++;
-        sleep_us(200);
+// Per task: how often it ran and its longest step, then the longest gap
+// between two tud_task() calls that bounds
+static void print_tasks(void) {
+    for (sched_task_t const *t = sched_tasks(); t; t = t->next) {
+        TRACE_LOG("TASK: %-8s %lu runs, max %lu us\r\n", t->name, t->runs, t->max_us);
     }
-    return (low_count >= 3);
+    TRACE_LOG("TASK: tud_task every %lu us at most (sleep excluded)\r\n", perf_task_interval_max_us());
 }
 
-void led_on(void) { gpio_put(GPIO_LED, 1); }
-void led_off(void) { gpio_put(GPIO_LED, 0); }
-
-void led_blink(int times, int ms) {
-    for (int i = 0; i < times; i++) {
-        led_on(); sleep_ms(ms);
-        led_off(); if (i < times - 1) sleep_ms(ms);
+// 'l' = the last face came out with missing keys, 'b' = matrix benchmark,
+// 's'/'r' = latency summary/reset, 'c' = stored settings, 't' = scheduler
+// tasks, digits select the macro (kept across restarts)
+static void handle_command(int32_t c) {
+    if (c == 'l') {
+        hid_queue_report_loss();
+        TRACE_LOG("PACING: loss reported, gap now %lu us\r\n", hid_queue_gap_us());
+    } else if (c == 'b') {
+        matrix_benchmark();
+    } else if (c == 's') {
+        trace_latency_summary();
+    } else if (c == 'r') {
+        latency_reset();
+        TRACE_LOG("LATENCY: statistics reset\r\n");
+    } else if (c == 'c') {
+        print_config();
+    } else if (c == 't') {
+        print_tasks();
+    } else if (c >= '0' && c <= '9' && (uint16_t)(c - '0') < macro_library_count()) {
+        lenny_core_select_macro((uint16_t)(c - '0'));
+        config_store_set(CONFIG_MACRO, lenny_core_macro());
+        TRACE_LOG("SELECT: macro %u\r\n", lenny_core_macro());
     }
 }
 
@@ -293,126 +258,103 @@ void led_blink(int times, int ms) {
 // Main
 //--------------------------------------------------------------------+
 
-int main(void) {
-    tusb_init();
-
-    // Setup GPIOs
-    gpio_init(GPIO_TRIGGER_OUT);
-    gpio_set_dir(GPIO_TRIGGER_OUT, GPIO_OUT);
-    gpio_put(GPIO_TRIGGER_OUT, 0);
-
-    gpio_init(GPIO_TRIGGER_IN);
-    gpio_set_dir(GPIO_TRIGGER_IN, GPIO_IN);
-    gpio_pull_up(GPIO_TRIGGER_IN);
-
-    gpio_init(GPIO_LED);
-    gpio_set_dir(GPIO_LED, GPIO_OUT);
-    led_off();
+static const uint8_t trigger_pins[] = { GPIO_TRIGGER_LINUX, GPIO_TRIGGER_WINDOWS };
+
+const lenny_config_t lenny_config = {
+    .input = {
+        .pins        = trigger_pins,
+        .pin_count   = 2,
+        .led_pin     = GPIO_LED,
+        .debounce_ms = DEBOUNCE_MS,
+        .cooldown_ms = TRIGGER_COOLDOWN_MS,
+    },
+    .detect_host = true,
+    .burst_ms    = BURST_HOLD_MS,
+    .companion   = true,
+    .ground_pin  = GPIO_TRIGGER_OUT,
+};
 
-    // Wait for USB enumeration
-    while (!tud_mounted()) {
-        tud_task();
-        sleep_ms(1);
-    }
-    
-    led_blink(3, 100);
-
-    // Wait for CDC connection
-    uint32_t cdc_wait_start = to_ms_since_boot(get_absolute_time());
-    while (!tud_cdc_connected()) {
-        tud_task();
-        sleep_ms(10);
-        // Timeout after 5 seconds
-        if (to_ms_since_boot(get_absolute_time()) - cdc_wait_start > 5000) break;
+static void banner_step(void);
+static void command_step(void);
+static void status_step(void);
+static sched_task_t banner_task = { .run = banner_step, .name = "banner" };
+static sched_task_t command_task = { .run = command_step, .name = "command" };
+static sched_task_t status_task = { .run = status_step, .name = "status" };
+static bool banner_done = false;
+
+// Once a terminal connects, or 5 seconds after enumeration without one
+static void banner_step(void) {
+    static uint32_t mounted_at = 0;
+    if (tud_mounted() && !mounted_at) mounted_at = to_ms_since_boot(get_absolute_time());
+    if (!mounted_at || (!tud_cdc_connected() &&
+                        to_ms_since_boot(get_absolute_time()) - mounted_at <= 5000)) {
+        sched_at(&banner_task, make_timeout_time_ms(10));
+        return;
     }
 
-    dbg_print("\r\n\r\n");
-    dbg_print("================================\r\n");
-    dbg_print("  LENNY FACE KEYBOARD - DEBUG\r\n");
-    dbg_print("================================\r\n");
-    dbg_printf("GPIO IN:  %d (pull-up)\r\n", GPIO_TRIGGER_IN);
-    dbg_printf("GPIO OUT: %d (always LOW)\r\n", GPIO_TRIGGER_OUT);
-    dbg_print("Short GPIO 4 to GPIO 5 to trigger\r\n");
-    dbg_print("--------------------------------\r\n\r\n");
-
-    trigger_state_t prev_state = state;
-    uint32_t last_status = 0;
-    uint32_t last_gpio_print = 0;
-
-    while (true) {
-        tud_task();
-
-        uint32_t now = to_ms_since_boot(get_absolute_time());
-        bool raw = read_gpio_raw();
-        bool stable = read_trigger_stable();
-
-        // Print GPIO status every 500ms when something is happening
-        if (raw && (now - last_gpio_print > 500)) {
-            dbg_printf("[%lu] GPIO: raw=%d stable=%d state=%s count=%d\r\n", 
-                       now, raw, stable, state_name(state), debounce_count);
-            last_gpio_print = now;
-        }
+    TRACE_LOG("\r\n\r\n");
+    TRACE_LOG("================================\r\n");
+    TRACE_LOG("  LENNY FACE KEYBOARD - DEBUG\r\n");
+    TRACE_LOG("================================\r\n");
+    TRACE_LOG("GPIO OUT: %d (always LOW)\r\n", GPIO_TRIGGER_OUT);
+    TRACE_LOG("Short GPIO 4 to GPIO %d (Linux) or GPIO %d (Windows)\r\n",
+              GPIO_TRIGGER_LINUX, GPIO_TRIGGER_WINDOWS);
+    TRACE_LOG("HOST: %s (pins only decide for an unknown host)\r\n",
+              host_detect_name(host_detect_os()));
+    TRACE_LOG("Macros go to tools/lenny_companion as text when it has the port open\r\n");
+    TRACE_LOG("Send 'l' if the host dropped keys (slows report pacing)\r\n");
+    TRACE_LOG("Send '0'-'9' to pick the macro typed on trigger (%u in flash, generation %lu)\r\n",
+              macro_library_count(), macro_upload_generation());
+    TRACE_LOG("Send 'b' to benchmark matrix scan time\r\n");
+    TRACE_LOG("Send 's' for a latency summary, 'r' to reset it\r\n");
+    TRACE_LOG("Send 'c' for the stored settings (set them with tools/lenny_config)\r\n");
+    TRACE_LOG("Send 't' for the scheduler tasks and the USB service interval\r\n");
+    TRACE_LOG("--------------------------------\r\n\r\n");
+
+    banner_done = true;
+    sched_post(&command_task);  // anything typed while we waited
+    sched_at(&status_task, from_us_since_boot(10000 * 1000));
+}
 
-        // State machine
-        switch (state) {
-            case STATE_IDLE:
-                if (stable) {
-                    state = STATE_DEBOUNCING;
-                    state_start_time = now;
-                    debounce_count = 1;
-                    dbg_printf("[%lu] -> DEBOUNCING (count=1)\r\n", now);
-                }
-                break;
-
-            case STATE_DEBOUNCING:
-                if (now - state_start_time >= DEBOUNCE_INTERVAL_MS) {
-                    if (stable) {
-                        debounce_count++;
-                        dbg_printf("[%lu] DEBOUNCE count=%d/%d\r\n", now, debounce_count, DEBOUNCE_SAMPLES);
-                        
-                        if (debounce_count >= DEBOUNCE_SAMPLES) {
-                            dbg_printf("[%lu] -> TRIGGERED!\r\n", now);
-                            led_on();
-                            type_lenny_face();
-                            led_off();
-                            state = STATE_TRIGGERED;
-                            state_start_time = now;
-                        } else {
-                            state_start_time = now;
-                        }
-                    } else {
-                        dbg_printf("[%lu] NOISE RESET (was at count=%d)\r\n", now, debounce_count);
-                        state = STATE_IDLE;
-                        debounce_count = 0;
-                    }
-                }
-                break;
-
-            case STATE_TRIGGERED:
-                if (!stable) {
-                    dbg_printf("[%lu] -> COOLDOWN (released)\r\n", now);
-                    state = STATE_COOLDOWN;
-                    state_start_time = now;
-                }
-                break;
-
-            case STATE_COOLDOWN:
-                if (now - state_start_time >= TRIGGER_COOLDOWN_MS) {
-                    dbg_printf("[%lu] -> IDLE (cooldown done)\r\n", now);
-                    state = STATE_IDLE;
-                }
-                break;
-        }
+// Commands and status wait until the current sequence has drained
+static void command_step(void) {
+    if (!banner_done || !tud_cdc_available()) return;
+    if (lenny_core_busy()) {
+        sched_post(&command_task);
+        return;
+    }
+    handle_command(tud_cdc_read_char());
+    if (tud_cdc_available()) sched_post(&command_task);
+}
 
-        // Print status every 10 seconds
-        if (now - last_status > 10000) {
-            dbg_printf("[%lu] STATUS: state=%s gpio_raw=%d gpio_stable=%d\r\n", 
-                       now, state_name(state), raw, stable);
-            last_status = now;
-        }
+void tud_cdc_rx_cb(uint8_t itf) {
+    (void)itf;
+    sched_post(&command_task);
+}
 
-        sleep_ms(2);
+// Every 10 seconds
+static void status_step(void) {
+    if (lenny_core_busy()) {
+        sched_post(&status_task);
+        return;
     }
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    // Two records, as dbg_log() keeps six arguments each
+    TRACE_LOG("[%lu] STATUS: state=%s host=%s edges=%lu rejects=%lu",
+              now, input_state_name(lenny_core_state()), host_detect_name(host_detect_os()),
+              trigger_edge_count(), trigger_reject_count());
+    TRACE_LOG(" loops/s=%lu clk=%lu kHz usb_max=%lu us\r\n",
+              power_loops_per_sec(), power_clock_khz(), perf_task_interval_max_us());
+    sched_at(&status_task, make_timeout_time_ms(10000));
+}
+
+int main(void) {
+    lenny_core_init();
+    sched_add(&banner_task);
+    sched_add(&command_task);
+    sched_add(&status_task);
+    sched_post(&banner_task);
+    sched_run();
 
     return 0;
 }
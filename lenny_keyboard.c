@@ -1,10 +1,26 @@
 // Lenny Face Keyboard - HID Only
 // Types ( ͡° ͜ʖ ͡°) via GPIO trigger
-// Supports Linux (Ctrl+Shift+U) and Windows (Alt+X)
+// Supports Linux (Ctrl+Shift+U) and Windows (Alt+X), picked from how the
+// host enumerates us (host_detect.c) - the trigger pin only decides when
+// the host could not be identified. Built with LENNY_COMPANION, it also
+// has a CDC port for the companion daemon (companion.h).
 
 #include "pico/stdlib.h"
-#include "hardware/gpio.h"
 #include "tusb.h"
+#include "hid_queue.h"
+#include "power.h"
+#include "perf.h"
+#include "host_detect.h"
+#include "macro_upload.h"
+#include "sched.h"
+#include "lenny_core.h"
+
+#ifndef LENNY_COMPANION
+#define LENNY_COMPANION 0
+#endif
+#if LENNY_COMPANION
+#include "companion.h"
+#endif
 
 #define GPIO_TRIGGER_OUT      4    // Ground reference
 #define GPIO_TRIGGER_LINUX    5    // Short to GPIO 4 for Linux mode
@@ -12,21 +28,31 @@
 #define GPIO_LED              25   // Pico onboard LED
 
 // Debounce settings
-#define DEBOUNCE_SAMPLES     8     // Number of consistent reads required
-#define DEBOUNCE_INTERVAL_MS 10    // Time between samples
+#define DEBOUNCE_MS          80    // Pin must be quiet this long after its last edge
 #define TRIGGER_COOLDOWN_MS  1000  // Minimum time between triggers
+#define BURST_HOLD_MS        500   // Held this long, the trigger repeats the face
 
 #define USB_VID 0xCafe
+#if LENNY_COMPANION
+#define USB_PID 0x4005  // Different interfaces, so a different PID
+#else
 #define USB_PID 0x4003
+#endif
 
 // Device descriptor
 tusb_desc_device_t const desc_device = {
     .bLength            = sizeof(tusb_desc_device_t),
     .bDescriptorType    = TUSB_DESC_DEVICE,
     .bcdUSB             = 0x0200,
+#if LENNY_COMPANION
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+#else
     .bDeviceClass       = 0x00,
     .bDeviceSubClass    = 0x00,
     .bDeviceProtocol    = 0x00,
+#endif
     .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
     .idVendor           = USB_VID,
     .idProduct          = USB_PID,
@@ -38,27 +64,45 @@ tusb_desc_device_t const desc_device = {
 };
 
 uint8_t const *tud_descriptor_device_cb(void) {
+    host_detect_descriptor(TUSB_DESC_DEVICE, 0);
     return (uint8_t const *)&desc_device;
 }
 
-// HID Report Descriptor
-uint8_t const desc_hid_report[] = { TUD_HID_REPORT_DESC_KEYBOARD() };
+// HID Report Descriptor - NKRO keyboard (boot-capable, see hid_queue.h) plus
+// the perf counters feature report
+uint8_t const desc_hid_report[] = { HID_QUEUE_REPORT_DESC_KEYBOARD(PERF_HID_REPORT_DESC_FEATURE) };
+
+// Vendor interface for macro uploads (macro_upload.h)
+uint8_t const desc_upload_report[] = { MACRO_UPLOAD_REPORT_DESC };
 
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance) {
-    (void)instance;
-    return desc_hid_report;
+    host_detect_descriptor(HID_DESC_TYPE_REPORT, instance);
+    return instance == MACRO_UPLOAD_INSTANCE ? desc_upload_report : desc_hid_report;
 }
 
 // Configuration descriptor
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#if LENNY_COMPANION
+// The companion daemon's CDC port first, laid out as in lenny_debug
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
 
 uint8_t const desc_configuration[] = {
-    TUD_CONFIG_DESCRIPTOR(1, 1, 0, CONFIG_TOTAL_LEN, 0, 100),
-    TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), 0x81, 16, 10)
+    TUD_CONFIG_DESCRIPTOR(1, 4, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_CDC_DESCRIPTOR(0, 0, 0x81, 8, 0x02, 0x82, 64),
+    TUD_HID_DESCRIPTOR(2, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), 0x83, 16, 1),
+    TUD_HID_INOUT_DESCRIPTOR(3, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_upload_report), 0x04, 0x84, MACRO_UPLOAD_REPORT_SIZE, 1)
 };
+#else
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+
+uint8_t const desc_configuration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, 2, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), 0x81, 16, 1),
+    TUD_HID_INOUT_DESCRIPTOR(1, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_upload_report), 0x02, 0x82, MACRO_UPLOAD_REPORT_SIZE, 1)
+};
+#endif
 
 uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
-    (void)index;
+    host_detect_descriptor(TUSB_DESC_CONFIGURATION, index);
     return desc_configuration;
 }
 
@@ -74,6 +118,7 @@ static uint16_t _desc_str[32];
 uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
     (void)langid;
     size_t chr_count;
+    host_detect_descriptor(TUSB_DESC_STRING, index);
 
     if (index == 0) {
         memcpy(&_desc_str[1], string_desc_arr[0], 2);
@@ -95,304 +140,78 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 
 // HID callbacks
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize) {
-    (void)instance; (void)report_id; (void)report_type; (void)buffer; (void)bufsize;
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE) macro_upload_receive(buffer, bufsize);
+    else if (report_type == HID_REPORT_TYPE_OUTPUT) host_detect_led_report();
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen) {
-    (void)instance; (void)report_id; (void)report_type; (void)buffer; (void)reqlen;
-    return 0;
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE || report_type != HID_REPORT_TYPE_FEATURE) return 0;
+    return perf_get_report(buffer, reqlen);
 }
 
-//--------------------------------------------------------------------+
-// Keyboard Functions
-//--------------------------------------------------------------------+
-
-void press_key(uint8_t modifier, uint8_t keycode) {
-    uint8_t keys[6] = {keycode, 0, 0, 0, 0, 0};
-    tud_hid_keyboard_report(0, modifier, keys);
-    sleep_ms(20);
-    tud_task();
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
+    (void)report; (void)len;
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_report_complete();
 }
 
-void release_keys(void) {
-    uint8_t keys[6] = {0};
-    tud_hid_keyboard_report(0, 0, keys);
-    sleep_ms(20);
-    tud_task();
+// Boot protocol - one key per report until the host goes away
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol) {
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_set_boot_protocol(protocol == HID_PROTOCOL_BOOT);
 }
 
-void type_key(uint8_t modifier, uint8_t keycode) {
-    press_key(modifier, keycode);
-    release_keys();
+#if LENNY_COMPANION
+// The companion daemon opens the port at COMPANION_BAUD
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding) {
+    (void)itf;
+    companion_line_coding(p_line_coding->bit_rate);
 }
+#endif
 
-// Type ASCII character
-void type_char(char c) {
-    uint8_t keycode = 0, modifier = 0;
-
-    if (c >= 'a' && c <= 'z') {
-        keycode = HID_KEY_A + (c - 'a');
-    } else if (c >= 'A' && c <= 'Z') {
-        keycode = HID_KEY_A + (c - 'A');
-        modifier = KEYBOARD_MODIFIER_LEFTSHIFT;
-    } else if (c >= '1' && c <= '9') {
-        keycode = HID_KEY_1 + (c - '1');
-    } else if (c == '0') {
-        keycode = HID_KEY_0;
-    } else {
-        switch (c) {
-            case ' ': keycode = HID_KEY_SPACE; break;
-            case '(': keycode = HID_KEY_9; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case ')': keycode = HID_KEY_0; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case '_': keycode = HID_KEY_MINUS; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            case '^': keycode = HID_KEY_6; modifier = KEYBOARD_MODIFIER_LEFTSHIFT; break;
-            default: return;
-        }
-    }
-    type_key(modifier, keycode);
+void tud_mount_cb(void) {
+    lenny_core_mounted();
 }
 
-// Type Unicode character using Linux Ctrl+Shift+U method
-void type_unicode_linux(uint16_t codepoint) {
-    // Press Ctrl+Shift+U
-    uint8_t keys[6] = {HID_KEY_U, 0, 0, 0, 0, 0};
-    tud_hid_keyboard_report(0, KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTSHIFT, keys);
-    sleep_ms(30);
-    tud_task();
-    release_keys();
-    sleep_ms(30);
-
-    // Type hex digits
-    char hex[5];
-    snprintf(hex, sizeof(hex), "%04x", codepoint);
-    for (int i = 0; i < 4; i++) {
-        char c = hex[i];
-        uint8_t keycode;
-        if (c >= '0' && c <= '9') {
-            keycode = (c == '0') ? HID_KEY_0 : HID_KEY_1 + (c - '1');
-        } else {
-            keycode = HID_KEY_A + (c - 'a');
-        }
-        type_key(0, keycode);
-    }
-
-    // Press Space to confirm
-    type_key(0, HID_KEY_SPACE);
+void tud_umount_cb(void) {
+    host_detect_reset();
 }
 
-// Type Unicode character using Windows Alt+X method
-// Works in Word, WordPad, and many other Windows apps
-void type_unicode_windows(uint16_t codepoint) {
-    // Type hex digits first
-    char hex[5];
-    snprintf(hex, sizeof(hex), "%04x", codepoint);
-    for (int i = 0; i < 4; i++) {
-        char c = hex[i];
-        uint8_t keycode;
-        if (c >= '0' && c <= '9') {
-            keycode = (c == '0') ? HID_KEY_0 : HID_KEY_1 + (c - '1');
-        } else {
-            keycode = HID_KEY_A + (c - 'a');
-        }
-        type_key(0, keycode);
-    }
-
-    // Press Alt+X to convert
-    uint8_t keys[6] = {HID_KEY_X, 0, 0, 0, 0, 0};
-    tud_hid_keyboard_report(0, KEYBOARD_MODIFIER_LEFTALT, keys);
-    sleep_ms(30);
-    tud_task();
-    release_keys();
-    sleep_ms(30);
+// Bus suspend - sleep deeper until the host resumes us or a trigger fires
+void tud_suspend_cb(bool remote_wakeup_en) {
+    power_suspend(remote_wakeup_en);
 }
 
-// Type the real Lenny face: ( ͡° ͜ʖ ͡°)
-void type_lenny_face_linux(void) {
-    if (!tud_hid_ready()) return;
-
-    type_char('(');
-    type_char(' ');
-    type_unicode_linux(0x0361);  // ͡ combining double inverted breve
-    type_unicode_linux(0x00b0);  // ° degree sign
-    type_char(' ');
-    type_unicode_linux(0x035c);  // ͜ combining double breve below
-    type_unicode_linux(0x0296);  // ʖ latin letter inverted glottal stop
-    type_char(' ');
-    type_unicode_linux(0x0361);  // ͡
-    type_unicode_linux(0x00b0);  // °
-    type_char(' ');
-    type_char(')');
-}
-
-void type_lenny_face_windows(void) {
-    if (!tud_hid_ready()) return;
-
-    type_char('(');
-    type_char(' ');
-    type_unicode_windows(0x0361);  // ͡ combining double inverted breve
-    type_unicode_windows(0x00b0);  // ° degree sign
-    type_char(' ');
-    type_unicode_windows(0x035c);  // ͜ combining double breve below
-    type_unicode_windows(0x0296);  // ʖ latin letter inverted glottal stop
-    type_char(' ');
-    type_unicode_windows(0x0361);  // ͡
-    type_unicode_windows(0x00b0);  // °
-    type_char(' ');
-    type_char(')');
-}
-
-//--------------------------------------------------------------------+
-// Debounce Logic
-//--------------------------------------------------------------------+
-
-typedef enum {
-    STATE_IDLE,
-    STATE_DEBOUNCING,
-    STATE_TRIGGERED,
-    STATE_COOLDOWN
-} trigger_state_t;
-
-static trigger_state_t state = STATE_IDLE;
-static uint32_t state_start_time = 0;
-static uint8_t debounce_count = 0;
-
-// Read GPIO with multiple samples for reliability
-typedef enum {
-    TRIGGER_NONE,
-    TRIGGER_LINUX,
-    TRIGGER_WINDOWS
-} trigger_mode_t;
-
-trigger_mode_t read_trigger_stable(void) {
-    int linux_count = 0;
-    int windows_count = 0;
-    
-    for (int i = 0; i < 5; i++) {
-        if (gpio_get(GPIO_TRIGGER_LINUX) == 0) linux_count++;
-        if (gpio_get(GPIO_TRIGGER_WINDOWS) == 0) windows_count++;
-        sleep_us(200);
-    }
-    
-    // Require majority vote (at least 3 out of 5)
-    if (linux_count >= 3) return TRIGGER_LINUX;
-    if (windows_count >= 3) return TRIGGER_WINDOWS;
-    return TRIGGER_NONE;
-}
-
-void led_blink(int times, int ms) {
-    for (int i = 0; i < times; i++) {
-        gpio_put(GPIO_LED, 1);
-        sleep_ms(ms);
-        gpio_put(GPIO_LED, 0);
-        if (i < times - 1) sleep_ms(ms);
-    }
+void tud_resume_cb(void) {
+    power_resume();
 }
 
 //--------------------------------------------------------------------+
 // Main
 //--------------------------------------------------------------------+
 
-int main(void) {
-    tusb_init();
-
-    // Setup trigger output (LOW) - ground reference
-    gpio_init(GPIO_TRIGGER_OUT);
-    gpio_set_dir(GPIO_TRIGGER_OUT, GPIO_OUT);
-    gpio_put(GPIO_TRIGGER_OUT, 0);
-
-    // Setup trigger inputs with pull-ups
-    gpio_init(GPIO_TRIGGER_LINUX);
-    gpio_set_dir(GPIO_TRIGGER_LINUX, GPIO_IN);
-    gpio_pull_up(GPIO_TRIGGER_LINUX);
-    
-    gpio_init(GPIO_TRIGGER_WINDOWS);
-    gpio_set_dir(GPIO_TRIGGER_WINDOWS, GPIO_IN);
-    gpio_pull_up(GPIO_TRIGGER_WINDOWS);
-
-    // Setup LED
-    gpio_init(GPIO_LED);
-    gpio_set_dir(GPIO_LED, GPIO_OUT);
-    gpio_put(GPIO_LED, 0);
-
-    // Wait for USB enumeration
-    while (!tud_mounted()) {
-        tud_task();
-        sleep_ms(1);
-    }
-
-    // Signal ready with LED
-    led_blink(3, 100);
-
-    trigger_mode_t active_mode = TRIGGER_NONE;
-
-    while (true) {
-        tud_task();
-
-        uint32_t now = to_ms_since_boot(get_absolute_time());
-        trigger_mode_t current_trigger = read_trigger_stable();
-
-        switch (state) {
-            case STATE_IDLE:
-                if (current_trigger != TRIGGER_NONE) {
-                    state = STATE_DEBOUNCING;
-                    state_start_time = now;
-                    debounce_count = 1;
-                    active_mode = current_trigger;
-                }
-                break;
-
-            case STATE_DEBOUNCING:
-                if (now - state_start_time >= DEBOUNCE_INTERVAL_MS) {
-                    if (current_trigger == active_mode) {
-                        debounce_count++;
-                        if (debounce_count >= DEBOUNCE_SAMPLES) {
-                            // Confirmed press - trigger!
-                            gpio_put(GPIO_LED, 1);
-                            
-                            if (active_mode == TRIGGER_LINUX) {
-                                // Blink once for Linux
-                                led_blink(1, 100);
-                                type_lenny_face_linux();
-                            } else {
-                                // Blink twice for Windows
-                                led_blink(2, 50);
-                                type_lenny_face_windows();
-                            }
-                            
-                            gpio_put(GPIO_LED, 0);
-                            state = STATE_TRIGGERED;
-                            state_start_time = now;
-                        } else {
-                            state_start_time = now;
-                        }
-                    } else {
-                        // Trigger changed or released, reset
-                        state = STATE_IDLE;
-                        debounce_count = 0;
-                        active_mode = TRIGGER_NONE;
-                    }
-                }
-                break;
-
-            case STATE_TRIGGERED:
-                // Wait for release
-                if (current_trigger == TRIGGER_NONE) {
-                    state = STATE_COOLDOWN;
-                    state_start_time = now;
-                }
-                break;
-
-            case STATE_COOLDOWN:
-                // Prevent re-trigger for cooldown period
-                if (now - state_start_time >= TRIGGER_COOLDOWN_MS) {
-                    state = STATE_IDLE;
-                    active_mode = TRIGGER_NONE;
-                }
-                break;
-        }
+// Core1 (input.c) debounces the pins, runs the trigger state machine and
+// drives the LED; core0 (lenny_core.c) only services USB and the report queue.
+// Either pin types for a detected host, so wiring just one is enough.
+static const uint8_t trigger_pins[] = { GPIO_TRIGGER_LINUX, GPIO_TRIGGER_WINDOWS };
+
+const lenny_config_t lenny_config = {
+    .input = {
+        .pins        = trigger_pins,
+        .pin_count   = 2,
+        .led_pin     = GPIO_LED,
+        .debounce_ms = DEBOUNCE_MS,
+        .cooldown_ms = TRIGGER_COOLDOWN_MS,
+    },
+    .detect_host = true,
+    .companion   = LENNY_COMPANION,
+    .burst_ms    = BURST_HOLD_MS,
+    .ground_pin  = GPIO_TRIGGER_OUT,
+};
 
-        sleep_ms(2);  // Small delay to prevent CPU hogging
-    }
+int main(void) {
+    lenny_core_init();
+    sched_run();
 
     return 0;
 }
@@ -0,0 +1,248 @@
+// Lenny Macro Pad - HID Only
+// Types a macro from the flash library per key of a scanned key matrix
+// Supports Linux (Ctrl+Shift+U) and Windows (Alt+X)
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "tusb.h"
+#include "hid_queue.h"
+#include "input.h"
+#include "matrix.h"
+#include "power.h"
+#include "perf.h"
+#include "host_detect.h"
+#include "macro_upload.h"
+#include "config_store.h"
+#include "macro_library.h"
+#include "sched.h"
+#include "lenny_macros.h"
+
+// Key matrix - up to 8x8. Rows are any GPIOs, columns must be contiguous.
+#define MATRIX_ROWS       4
+#define MATRIX_COLS       4
+#define GPIO_ROW_FIRST    6    // rows on GPIO 6-9
+#define GPIO_COL_FIRST    10   // columns on GPIO 10-13
+#define GPIO_LED          25   // Pico onboard LED, lit while a key is down
+
+// Unicode input method used for every key when the host OS was not detected
+#define MACROPAD_METHOD   MACRO_METHOD_LINUX
+
+#define USB_VID 0xCafe
+#define USB_PID 0x4005
+
+// Device descriptor
+tusb_desc_device_t const desc_device = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0200,
+    .bDeviceClass       = 0x00,
+    .bDeviceSubClass    = 0x00,
+    .bDeviceProtocol    = 0x00,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_VID,
+    .idProduct          = USB_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0x01,
+    .iProduct           = 0x02,
+    .iSerialNumber      = 0x00,
+    .bNumConfigurations = 0x01
+};
+
+uint8_t const *tud_descriptor_device_cb(void) {
+    host_detect_descriptor(TUSB_DESC_DEVICE, 0);
+    return (uint8_t const *)&desc_device;
+}
+
+// HID Report Descriptor - NKRO keyboard (boot-capable, see hid_queue.h) plus
+// the perf counters feature report
+uint8_t const desc_hid_report[] = { HID_QUEUE_REPORT_DESC_KEYBOARD(PERF_HID_REPORT_DESC_FEATURE) };
+
+// Vendor interface for macro uploads (macro_upload.h)
+uint8_t const desc_upload_report[] = { MACRO_UPLOAD_REPORT_DESC };
+
+uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance) {
+    host_detect_descriptor(HID_DESC_TYPE_REPORT, instance);
+    return instance == MACRO_UPLOAD_INSTANCE ? desc_upload_report : desc_hid_report;
+}
+
+// Configuration descriptor
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+
+uint8_t const desc_configuration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, 2, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_HID_DESCRIPTOR(0, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), 0x81, 16, 1),
+    TUD_HID_INOUT_DESCRIPTOR(1, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_upload_report), 0x02, 0x82, MACRO_UPLOAD_REPORT_SIZE, 1)
+};
+
+uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
+    host_detect_descriptor(TUSB_DESC_CONFIGURATION, index);
+    return desc_configuration;
+}
+
+// String descriptors
+char const *string_desc_arr[] = {
+    (const char[]){0x09, 0x04},
+    "Pico",
+    "Lenny Macro Pad",
+};
+
+static uint16_t _desc_str[32];
+
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    (void)langid;
+    size_t chr_count;
+    host_detect_descriptor(TUSB_DESC_STRING, index);
+
+    if (index == 0) {
+        memcpy(&_desc_str[1], string_desc_arr[0], 2);
+        chr_count = 1;
+    } else {
+        if (index >= sizeof(string_desc_arr) / sizeof(string_desc_arr[0]))
+            return NULL;
+        const char *str = string_desc_arr[index];
+        chr_count = strlen(str);
+        if (chr_count > 31) chr_count = 31;
+        for (size_t i = 0; i < chr_count; i++) {
+            _desc_str[1 + i] = str[i];
+        }
+    }
+
+    _desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * chr_count + 2));
+    return _desc_str;
+}
+
+// HID callbacks
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize) {
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE) macro_upload_receive(buffer, bufsize);
+    else if (report_type == HID_REPORT_TYPE_OUTPUT) host_detect_led_report();
+}
+
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen) {
+    (void)report_id;
+    if (instance == MACRO_UPLOAD_INSTANCE || report_type != HID_REPORT_TYPE_FEATURE) return 0;
+    return perf_get_report(buffer, reqlen);
+}
+
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
+    (void)report; (void)len;
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_report_complete();
+}
+
+// Boot protocol - one key per report until the host goes away
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol) {
+    if (instance != MACRO_UPLOAD_INSTANCE) hid_queue_set_boot_protocol(protocol == HID_PROTOCOL_BOOT);
+}
+
+void tud_umount_cb(void) {
+    host_detect_reset();
+}
+
+// Bus suspend - sleep deeper until the host resumes us or a trigger fires
+void tud_suspend_cb(bool remote_wakeup_en) {
+    power_suspend(remote_wakeup_en);
+}
+
+void tud_resume_cb(void) {
+    power_resume();
+}
+
+//--------------------------------------------------------------------+
+// Keyboard Functions
+//--------------------------------------------------------------------+
+
+// Key k types macro k of the flash library (wrapping if there are more keys
+// than macros). Presses queue behind each other - the queue holds a table
+// reference per press, so nothing waits for the previous macro to finish.
+static bool type_key(uint8_t key) {
+    uint16_t count = macro_library_count();
+    if (count == 0 || !tud_hid_ready()) return false;
+
+    power_run();
+    return macro_library_type(key % count, host_detect_method(MACROPAD_METHOD));
+}
+
+//--------------------------------------------------------------------+
+// Main
+//--------------------------------------------------------------------+
+
+// Core1 (input.c) scans the matrix at 1 kHz and forwards key events; core0
+// only services USB and the report queue
+static const uint8_t row_pins[MATRIX_ROWS] = {
+    GPIO_ROW_FIRST, GPIO_ROW_FIRST + 1, GPIO_ROW_FIRST + 2, GPIO_ROW_FIRST + 3
+};
+
+static const matrix_config_t matrix_config = {
+    .row_pins = row_pins,
+    .rows     = MATRIX_ROWS,
+    .col_base = GPIO_COL_FIRST,
+    .cols     = MATRIX_COLS,
+};
+
+static const input_config_t input_config = {
+    .led_pin = GPIO_LED,
+    .matrix  = &matrix_config,
+};
+
+// Only the report pacing floor and the layout apply here; the matrix
+// debounces itself
+static void config_changed(config_key_t key) {
+    if (key == CONFIG_MIN_GAP_US) hid_queue_set_min_gap_us(config_store_get(key, HID_PACING_MIN_GAP_US));
+    if (key == CONFIG_LAYOUT) macro_library_select_layout((uint8_t)config_store_get(key, MACRO_LIB_DEFAULT_LAYOUT));
+}
+
+static void start_step(void);
+static void keys_step(void);
+static void typing_step(void);
+static sched_task_t start_task = { .run = start_step, .name = "start" };
+static sched_task_t keys_task = { .run = keys_step, .name = "keys", .on_wake = true };
+static sched_task_t typing_task = { .run = typing_step, .name = "typing", .on_wake = true };
+
+// Core1 starts once the host has enumerated us
+static void start_step(void) {
+    static bool launched = false;
+    if (launched) return;
+    input_launch(&input_config);
+    launched = true;
+}
+
+void tud_mount_cb(void) {
+    sched_post(&start_task);
+}
+
+static void keys_step(void) {
+    input_msg_t msg;
+    while (input_pop(&msg)) {
+        if (msg.type != INPUT_MSG_KEY || !msg.key.pressed) continue;
+
+        // Suspended: a key press wakes the host but is not typed
+        if (power_suspended()) {
+            if (power_remote_wakeup_allowed()) tud_remote_wakeup();
+            continue;
+        }
+        type_key(msg.key.key);
+    }
+}
+
+// Yields while macros drain, so USB is serviced flat out until then
+static void typing_step(void) {
+    hid_queue_task();
+    if (hid_queue_busy()) sched_post(&typing_task);
+}
+
+int main(void) {
+    power_init();
+    tusb_init();
+    hid_queue_init();
+    macro_upload_init(lenny_library, NULL);  // keys pick key % count when pressed
+    config_store_init(config_changed);
+    config_changed(CONFIG_MIN_GAP_US);
+    config_changed(CONFIG_LAYOUT);
+
+    sched_add(&start_task);
+    sched_add(&keys_task);
+    sched_add(&typing_task);
+    sched_run();
+
+    return 0;
+}
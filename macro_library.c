@@ -0,0 +1,82 @@
+// Flash-resident macro library - header index lookup, streamed from XIP
+
+#include <stddef.h>
+#include "macro_library.h"
+
+static macro_lib_header_t const *library = NULL;
+static uint8_t wanted_layout = MACRO_LIB_DEFAULT_LAYOUT;
+static uint8_t layout_index = 0;   // position of wanted_layout in library->layouts, or 0
+
+static inline macro_lib_entry_t const *index_base(void) {
+    return (macro_lib_entry_t const *)(library + 1);
+}
+
+bool macro_library_attach(void const *base) {
+    macro_lib_header_t const *hdr = (macro_lib_header_t const *)base;
+    if (hdr->magic != MACRO_LIB_MAGIC || hdr->version != MACRO_LIB_VERSION) return false;
+    if (hdr->layout_count == 0 || hdr->layout_count > MACRO_LIB_MAX_LAYOUTS) return false;
+
+    uint32_t index_end = sizeof(*hdr) +
+        (uint32_t)hdr->count * hdr->layout_count * MACRO_METHOD_COUNT * sizeof(macro_lib_entry_t);
+    if (hdr->size < index_end) return false;
+    if (hdr->text_offset < index_end || (hdr->text_offset & 3) ||
+        hdr->size < hdr->text_offset + (uint32_t)hdr->count * sizeof(macro_lib_entry_t)) return false;
+
+    library = hdr;
+    macro_library_select_layout(wanted_layout);
+    return true;
+}
+
+bool macro_library_select_layout(uint8_t layout) {
+    wanted_layout = layout;
+    layout_index = 0;
+    if (!library) return false;
+    for (uint8_t i = 0; i < library->layout_count; i++) {
+        if (library->layouts[i] == layout) {
+            layout_index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t macro_library_layout(void) {
+    return library ? library->layouts[layout_index] : wanted_layout;
+}
+
+uint16_t macro_library_count(void) {
+    return library ? library->count : 0;
+}
+
+bool macro_library_get(uint16_t id, macro_method_t method,
+                       hid_report_t const **reports, uint16_t *len) {
+    if (!library || id >= library->count || method >= MACRO_METHOD_COUNT) return false;
+
+    uint32_t slot = ((uint32_t)id * library->layout_count + layout_index) * MACRO_METHOD_COUNT + method;
+    macro_lib_entry_t const *e = &index_base()[slot];
+    if (!(e->flags & MACRO_FLAG_PRESENT)) return false;
+    if (e->offset + (uint32_t)e->length * sizeof(hid_report_t) > library->size) return false;
+
+    *reports = (hid_report_t const *)((uint8_t const *)library + e->offset);
+    *len = e->length;
+    return true;
+}
+
+bool macro_library_text(uint16_t id, char const **text, uint16_t *len) {
+    if (!library || id >= library->count) return false;
+
+    macro_lib_entry_t const *e = (macro_lib_entry_t const *)((uint8_t const *)library + library->text_offset) + id;
+    if (!(e->flags & MACRO_FLAG_PRESENT)) return false;
+    if (e->offset + (uint32_t)e->length + 1 > library->size) return false;
+
+    *text = (char const *)library + e->offset;
+    *len = e->length;
+    return true;
+}
+
+bool macro_library_type(uint16_t id, macro_method_t method) {
+    hid_report_t const *reports;
+    uint16_t len;
+    if (!macro_library_get(id, method, &reports, &len)) return false;
+    return hid_queue_push_table(reports, len);
+}
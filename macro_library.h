@@ -0,0 +1,81 @@
+#ifndef MACRO_LIBRARY_H
+#define MACRO_LIBRARY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hid_queue.h"
+
+// Flash-resident macro library
+//
+// One contiguous, read-only image (built from macros.txt by tools/lenny_gen)
+// that the firmware reads in place through XIP:
+//
+//   macro_lib_header_t
+//   macro_lib_entry_t index[count * layout_count * MACRO_METHOD_COUNT]
+//   hid_report_t      reports[]   - each macro contiguous, in index order
+//   macro_lib_entry_t texts[count] - at text_offset, 4-byte aligned
+//   char              utf8[]      - each macro's source text, NUL-terminated
+//
+// Every macro is compiled once per input method and host keyboard layout
+// (keymap.h). Index slot for (id, layout, method) is
+// (id * layout_count + layout) * MACRO_METHOD_COUNT + method, where layout
+// is the position in the header's layouts[], so a lookup is one read. Report runs are handed to hid_queue by pointer and
+// streamed sequentially from flash; nothing is copied to RAM, so library
+// size does not cost RAM. All fields are little-endian.
+
+#define MACRO_LIB_MAGIC   0x594E4E4C  // "LNNY"
+#define MACRO_LIB_VERSION 3
+#define MACRO_LIB_MAX_LAYOUTS 3
+#define MACRO_LIB_DEFAULT_LAYOUT 0xFF  // select: whichever the library lists first
+
+typedef enum {
+    MACRO_METHOD_LINUX,    // Ctrl+Shift+U <hex> Space
+    MACRO_METHOD_WINDOWS,  // <hex> Alt+X
+    MACRO_METHOD_COUNT
+} macro_method_t;
+
+#define MACRO_FLAG_PRESENT 0x01
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;     // macro ids
+    uint32_t size;      // bytes from the start of the header to the end of the image
+    uint32_t text_offset; // byte offset of the text index from the header
+    uint8_t layout_count; // layouts compiled in, 1..MACRO_LIB_MAX_LAYOUTS
+    uint8_t layouts[MACRO_LIB_MAX_LAYOUTS]; // keymap_layout_t; the first is the default
+} macro_lib_header_t;
+
+// Report table (index) or UTF-8 text (texts) of one macro
+typedef struct {
+    uint32_t offset;    // byte offset of the first report / byte from the header
+    uint16_t length;    // reports / bytes, without the NUL
+    uint8_t method;     // macro_method_t, MACRO_METHOD_COUNT for text
+    uint8_t flags;      // MACRO_FLAG_*
+} macro_lib_entry_t;
+
+// Use the library image at base (in flash). Returns false and keeps the
+// previous library if the header is not valid.
+bool macro_library_attach(void const *base);
+
+uint16_t macro_library_count(void);
+
+// Host keyboard layout (keymap_layout_t, or MACRO_LIB_DEFAULT_LAYOUT) to
+// type for. Kept across attach; while the library does not have it, its
+// first layout is used. Returns false if the attached library lacks it.
+bool macro_library_select_layout(uint8_t layout);
+uint8_t macro_library_layout(void);  // the layout in use
+
+// O(1) lookup in the selected layout. Returns false if id is out of range
+// or has no table for the method. *reports points into the library image.
+bool macro_library_get(uint16_t id, macro_method_t method,
+                       hid_report_t const **reports, uint16_t *len);
+
+// The macro's text as written in macros.txt - UTF-8, NUL-terminated, in
+// the library image. For hosts that can take text without typing it.
+bool macro_library_text(uint16_t id, char const **text, uint16_t *len);
+
+// Queue a macro for typing straight from flash
+bool macro_library_type(uint16_t id, macro_method_t method);
+
+#endif
@@ -0,0 +1,331 @@
+// Macro library upload - double-buffered flash slots fed from vendor HID
+
+#include <string.h>
+#include "macro_upload.h"
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "tusb.h"
+#include "hid_queue.h"
+#include "flash_op.h"
+#include "config_store.h"
+#include "power.h"
+#include "macro_library.h"
+#include "sched.h"
+
+#define SLOT_MAGIC   0x50554E4C  // "LNUP"
+#define SLOT_COUNT   2
+
+// Slots sit just below the config store, each 64 KB block aligned
+#define SLOT_OFFSET(n) (CONFIG_STORE_OFFSET - (SLOT_COUNT - (n)) * MACRO_UPLOAD_SLOT_SIZE)
+
+// First page of a slot; the image follows in the next page
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t length;     // image bytes
+    uint32_t crc;        // CRC-32 of the image
+} slot_header_t;
+
+static int active_slot = -1;          // -1 = built-in library
+static uint32_t active_generation = 0;
+static void (*on_attach)(void);
+
+// Upload in progress
+static bool receiving = false;
+static int target_slot;
+static uint32_t expected_len;
+static uint32_t expected_crc;
+static uint32_t received;
+static uint32_t erased;               // bytes of the slot erased so far
+static uint32_t erase_len;            // 0 = no erase running
+static uint8_t page[FLASH_PAGE_SIZE];
+
+// Config write waiting for the store to erase a sector
+static bool config_waiting = false;
+static config_key_t config_key;
+static bool config_set;
+static uint32_t config_value;
+
+static void erase_step(void);
+static void config_step(void);
+static sched_task_t erase_task = { .run = erase_step, .name = "upload" };
+static sched_task_t config_task = { .run = config_step, .name = "config" };
+
+static inline slot_header_t const *slot_header(int n) {
+    return (slot_header_t const *)(XIP_BASE + SLOT_OFFSET(n));
+}
+
+static inline uint8_t const *slot_image(int n) {
+    return (uint8_t const *)(XIP_BASE + SLOT_OFFSET(n) + FLASH_PAGE_SIZE);
+}
+
+// CRC-32 (IEEE 802.3, reflected), a nibble at a time
+static uint32_t crc32_update(uint32_t crc, uint8_t const *p, uint32_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0xF];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+    }
+    return ~crc;
+}
+
+// A slot is valid if its header, CRC and library header all check out
+static bool slot_valid(int n) {
+    slot_header_t const *h = slot_header(n);
+    if (h->magic != SLOT_MAGIC || h->length < sizeof(macro_lib_header_t) ||
+        h->length > MACRO_UPLOAD_MAX_IMAGE) return false;
+
+    macro_lib_header_t const *lib = (macro_lib_header_t const *)slot_image(n);
+    if (lib->size > h->length) return false;
+    return crc32_update(0, slot_image(n), h->length) == h->crc;
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+
+// Program the buffered page of image data ending at received
+static void flush_page(void) {
+    uint32_t used = received % FLASH_PAGE_SIZE;
+    if (used == 0) used = FLASH_PAGE_SIZE;
+    memset(page + used, 0xFF, FLASH_PAGE_SIZE - used);
+
+    uint32_t page_start = (received - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    flash_op_program(SLOT_OFFSET(target_slot) + FLASH_PAGE_SIZE + page_start, page, FLASH_PAGE_SIZE);
+}
+
+//--------------------------------------------------------------------+
+// Protocol
+//--------------------------------------------------------------------+
+
+static inline uint32_t get_u32(uint8_t const *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static void reply(uint8_t cmd, upload_status_t status) {
+    uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { cmd, (uint8_t)status };
+    put_u32(&r[2], received);
+    put_u32(&r[6], active_generation);
+    uint16_t count = macro_library_count();
+    r[10] = (uint8_t)count;
+    r[11] = (uint8_t)(count >> 8);
+    r[12] = (uint8_t)active_slot;
+    tud_hid_n_report(MACRO_UPLOAD_INSTANCE, 0, r, sizeof(r));
+}
+
+static void config_reply(uint8_t cmd, upload_status_t status, config_key_t key) {
+    uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { cmd, (uint8_t)status, (uint8_t)key };
+    if (status == UPLOAD_OK) {
+        r[3] = config_store_is_set(key);
+        put_u32(&r[4], config_store_get(key, 0));
+    }
+    tud_hid_n_report(MACRO_UPLOAD_INSTANCE, 0, r, sizeof(r));
+}
+
+static upload_status_t config_write(config_key_t key, bool set, uint32_t value) {
+    bool ok = set ? config_store_set(key, value) : config_store_clear(key);
+    return ok ? UPLOAD_OK : UPLOAD_BAD_CRC;
+}
+
+// Config store access over the same interface
+static void config_command(uint8_t const *report, uint16_t len) {
+    upload_status_t status = UPLOAD_OK;
+    config_key_t key = len >= 2 ? (config_key_t)report[1] : CONFIG_KEY_COUNT;
+
+    if (key >= CONFIG_KEY_COUNT || (report[0] == MACRO_UPLOAD_CONFIG_SET && len < 7)) {
+        status = UPLOAD_BAD_COMMAND;
+    } else if (report[0] == MACRO_UPLOAD_CONFIG_SET) {
+        // Same as uploads: the erase would stall a sequence being typed
+        if (hid_queue_busy() || config_waiting) {
+            status = UPLOAD_BUSY;
+        } else if (config_store_write_erases()) {
+            // Not from this callback - answered once written (config_step())
+            config_waiting = true;
+            config_key = key;
+            config_set = report[2];
+            config_value = get_u32(&report[3]);
+            sched_post(&config_task);
+            return;
+        } else {
+            status = config_write(key, report[2], get_u32(&report[3]));
+        }
+    }
+    config_reply(report[0], status, key);
+}
+
+// A config write that starts a new store sector: the erase is a task step
+// of its own, then the write only programs pages
+static void config_step(void) {
+    if (hid_queue_busy()) {
+        sched_post(&config_task);
+        return;
+    }
+
+    power_run();
+    config_store_prepare();
+    config_waiting = false;
+    config_reply(MACRO_UPLOAD_CONFIG_SET, config_write(config_key, config_set, config_value), config_key);
+}
+
+// Starts the erase; the reply goes out once it is done (erase_step())
+static upload_status_t begin(uint32_t len, uint32_t crc) {
+    if (len < sizeof(macro_lib_header_t) || len > MACRO_UPLOAD_MAX_IMAGE) return UPLOAD_TOO_BIG;
+    // A sequence may still be reading the slot about to be erased
+    if (hid_queue_busy() || erase_len) return UPLOAD_BUSY;
+
+    power_run();
+    target_slot = active_slot == 0 ? 1 : 0;
+    expected_len = len;
+    expected_crc = crc;
+    received = 0;
+    receiving = false;
+
+    // The header page and every sector the image touches, up front, so
+    // data reports only ever program pages
+    erased = 0;
+    erase_len = (FLASH_PAGE_SIZE + len + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE;
+    sched_post(&erase_task);
+    return UPLOAD_OK;
+}
+
+// One sector per step rather than the whole slot from the TinyUSB callback,
+// so USB is serviced between sectors. Waits while a sequence is typing:
+// the flash is unreadable during an erase, which would stall it.
+static void erase_step(void) {
+    if (hid_queue_busy()) {
+        sched_post(&erase_task);
+        return;
+    }
+
+    flash_op_erase(SLOT_OFFSET(target_slot) + erased, FLASH_SECTOR_SIZE);
+    erased += FLASH_SECTOR_SIZE;
+    if (erased < erase_len) {
+        sched_post(&erase_task);
+        return;
+    }
+
+    erase_len = 0;
+    receiving = true;
+    reply(MACRO_UPLOAD_BEGIN, UPLOAD_OK);
+}
+
+static upload_status_t data(uint32_t offset, uint8_t const *p, uint32_t len) {
+    if (!receiving) return UPLOAD_NOT_STARTED;
+    if (offset != received) return UPLOAD_OUT_OF_ORDER;
+    if (len > expected_len - received) len = expected_len - received;
+
+    while (len) {
+        uint32_t at = received % FLASH_PAGE_SIZE;
+        uint32_t n = FLASH_PAGE_SIZE - at < len ? FLASH_PAGE_SIZE - at : len;
+        memcpy(page + at, p, n);
+        received += n;
+        p += n;
+        len -= n;
+        if (received % FLASH_PAGE_SIZE == 0) flush_page();
+    }
+    return UPLOAD_OK;
+}
+
+static upload_status_t commit(void) {
+    if (!receiving) return UPLOAD_NOT_STARTED;
+    if (received < expected_len) return UPLOAD_SHORT;
+    receiving = false;
+
+    power_run();
+    if (received % FLASH_PAGE_SIZE) flush_page();
+
+    // Check what actually landed in flash, not what was received
+    if (crc32_update(0, slot_image(target_slot), expected_len) != expected_crc) return UPLOAD_BAD_CRC;
+    macro_lib_header_t const *lib = (macro_lib_header_t const *)slot_image(target_slot);
+    if (lib->magic != MACRO_LIB_MAGIC || lib->version != MACRO_LIB_VERSION || lib->size > expected_len) {
+        return UPLOAD_BAD_IMAGE;
+    }
+
+    // The header makes the slot valid - until here a reset keeps the old set
+    memset(page, 0xFF, sizeof(page));
+    slot_header_t h = { SLOT_MAGIC, active_generation + 1, expected_len, expected_crc };
+    memcpy(page, &h, sizeof(h));
+    flash_op_program(SLOT_OFFSET(target_slot), page, FLASH_PAGE_SIZE);
+
+    if (!macro_library_attach(slot_image(target_slot))) return UPLOAD_BAD_IMAGE;
+    active_slot = target_slot;
+    active_generation = h.generation;
+    if (on_attach) on_attach();
+    return UPLOAD_OK;
+}
+
+void macro_upload_receive(uint8_t const *report, uint16_t len) {
+    if (len < 1) return;
+    upload_status_t status;
+
+    switch (report[0]) {
+        case MACRO_UPLOAD_BEGIN:
+            status = len >= 9 ? begin(get_u32(&report[1]), get_u32(&report[5])) : UPLOAD_BAD_COMMAND;
+            if (status == UPLOAD_OK) return;  // replied once erased
+            break;
+        case MACRO_UPLOAD_DATA:
+            if (len < 5) return;
+            status = data(report[1] | (uint32_t)report[2] << 8 | (uint32_t)report[3] << 16,
+                          &report[4], len - 4u);
+            if (status == UPLOAD_OK) return;  // streamed - no reply
+            receiving = false;
+            break;
+        case MACRO_UPLOAD_COMMIT:
+            status = commit();
+            break;
+        case MACRO_UPLOAD_STATUS:
+            status = UPLOAD_OK;
+            break;
+        case MACRO_UPLOAD_CONFIG_GET:
+        case MACRO_UPLOAD_CONFIG_SET:
+            config_command(report, len);
+            return;
+        default:
+            status = UPLOAD_BAD_COMMAND;
+            break;
+    }
+    reply(report[0], status);
+}
+
+//--------------------------------------------------------------------+
+// Start-up
+//--------------------------------------------------------------------+
+
+void macro_upload_init(void const *builtin, void (*attached)(void)) {
+    on_attach = attached;
+    sched_add(&erase_task);
+    sched_add(&config_task);
+    macro_library_attach(builtin);
+
+    // Newest valid slot first; fall back to the other, then the built-in
+    int order[SLOT_COUNT] = { 0, 1 };
+    if (slot_header(1)->generation > slot_header(0)->generation) {
+        order[0] = 1;
+        order[1] = 0;
+    }
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        int n = order[i];
+        if (slot_valid(n) && macro_library_attach(slot_image(n))) {
+            active_slot = n;
+            active_generation = slot_header(n)->generation;
+            return;
+        }
+    }
+}
+
+uint32_t macro_upload_generation(void) {
+    return active_generation;
+}
+
+int macro_upload_slot(void) {
+    return active_slot;
+}
@@ -0,0 +1,80 @@
+#ifndef MACRO_UPLOAD_H
+#define MACRO_UPLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runtime macro library upload over a vendor-defined HID interface
+//
+// Two flash slots just below the config store (config_store.h) hold
+// uploaded library images (macro_library.h format, as written by lenny_gen
+// to <name>.bin). An upload always goes to the slot that is not active.
+// The slot's header page is programmed last, after the CRC of the data has
+// been checked in flash, so an interrupted upload leaves a slot without a
+// valid header and the active library untouched. At boot the valid slot
+// with the highest generation is attached, or the built-in library if
+// there is none.
+//
+// Protocol - 64-byte reports, no report IDs. OUT, byte 0 is the command:
+//   'B' size:u32 crc32:u32     begin: erase the inactive slot for size bytes
+//   'D' offset:u24 data[60]    image data, in order; the last may be short
+//   'C'                        commit: verify, write the header, switch to it
+//   'S'                        status
+// IN, in reply to B, C and S, and to a refused D:
+//   cmd:u8 status:u8 received:u32 generation:u32 count:u16 slot:u8
+// Data reports are not acknowledged, so the host can send one per frame.
+// All fields are little-endian; the CRC is CRC-32 (IEEE) of the image.
+//
+// The same interface reads and writes the config store:
+//   'G' key:u8                 get
+//   'K' key:u8 set:u8 value:u32
+//                              set, or with set = 0 back to the default
+// IN, in reply to both:
+//   cmd:u8 status:u8 key:u8 set:u8 value:u32
+
+#define MACRO_UPLOAD_INSTANCE     1      // second HID interface in every image
+#define MACRO_UPLOAD_REPORT_SIZE  64
+#define MACRO_UPLOAD_DATA_SIZE    60     // image bytes per 'D' report
+
+#define MACRO_UPLOAD_SLOT_SIZE    (64 * 1024)
+#define MACRO_UPLOAD_MAX_IMAGE    (MACRO_UPLOAD_SLOT_SIZE - 256)  // less the header page
+
+#define MACRO_UPLOAD_BEGIN        'B'
+#define MACRO_UPLOAD_DATA         'D'
+#define MACRO_UPLOAD_COMMIT       'C'
+#define MACRO_UPLOAD_STATUS       'S'
+#define MACRO_UPLOAD_CONFIG_GET   'G'
+#define MACRO_UPLOAD_CONFIG_SET   'K'
+
+typedef enum {
+    UPLOAD_OK,
+    UPLOAD_BUSY,            // a sequence is typing - try again
+    UPLOAD_TOO_BIG,
+    UPLOAD_NOT_STARTED,     // data or commit without a begin
+    UPLOAD_OUT_OF_ORDER,    // data offset is not the next byte expected
+    UPLOAD_SHORT,           // commit before size bytes arrived
+    UPLOAD_BAD_CRC,         // flash contents do not match the CRC
+    UPLOAD_BAD_IMAGE,       // not a library this firmware can read
+    UPLOAD_BAD_COMMAND,     // or a config key this firmware does not have
+} upload_status_t;
+
+// Vendor report descriptor for the upload interface
+#define MACRO_UPLOAD_REPORT_DESC  TUD_HID_REPORT_DESC_GENERIC_INOUT(MACRO_UPLOAD_REPORT_SIZE)
+
+// Attach the newest valid uploaded library, or builtin if there is none,
+// and add the erase tasks. Call instead of macro_library_attach() at start-up.
+// on_attach (may be NULL) is called once a committed upload has replaced
+// the library, to check macro ids held elsewhere against the new count.
+void macro_upload_init(void const *builtin, void (*on_attach)(void));
+
+// Call from tud_hid_set_report_cb() for MACRO_UPLOAD_INSTANCE. Flash is
+// programmed from here (flash_op.h). Erases never are: a begin, and a
+// config write that starts a new store sector, erase from a scheduler task
+// (sched.h) one sector per step and are answered when done.
+void macro_upload_receive(uint8_t const *report, uint16_t len);
+
+// Generation of the attached library (0 = built-in) and its slot (-1)
+uint32_t macro_upload_generation(void);
+int macro_upload_slot(void);
+
+#endif
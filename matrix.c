@@ -0,0 +1,126 @@
+// Key-matrix scanner - packed-bitmap vertical-counter debounce
+
+#include "matrix.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#define EVENT_RING_SIZE 32  // power of two
+
+static matrix_config_t const *config;
+static uint32_t col_mask;
+
+// Debounced key state plus a 2-bit counter per key, stored as two bit
+// planes (vertical counter). A key flips only after MATRIX_DEBOUNCE_SCANS
+// consecutive scans disagree with its debounced state.
+static uint64_t state;
+static uint64_t count0;
+static uint64_t count1;
+
+// Confirmed events: written by the scan, read by the input loop
+static matrix_event_t event_ring[EVENT_RING_SIZE];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_tail = 0;
+
+static uint32_t scan_us_max = 0;
+static uint32_t dropped = 0;
+
+static void select_row(uint8_t pin) {
+    gpio_set_dir(pin, GPIO_OUT);  // output value is preset low
+}
+
+// Unselected rows float, so a pressed key never shorts two driven rows
+static void release_row(uint8_t pin) {
+    gpio_set_dir(pin, GPIO_IN);
+}
+
+void matrix_init(matrix_config_t const *cfg) {
+    config = cfg;
+    col_mask = (1u << cfg->cols) - 1;
+    state = count0 = count1 = 0;
+    event_head = event_tail = 0;
+    scan_us_max = 0;
+
+    for (uint8_t r = 0; r < cfg->rows; r++) {
+        gpio_init(cfg->row_pins[r]);
+        gpio_put(cfg->row_pins[r], 0);
+        release_row(cfg->row_pins[r]);
+    }
+    for (uint8_t c = 0; c < cfg->cols; c++) {
+        gpio_init(cfg->col_base + c);
+        gpio_set_dir(cfg->col_base + c, GPIO_IN);
+        gpio_pull_up(cfg->col_base + c);
+    }
+}
+
+static void push_event(uint8_t bit, bool pressed, uint64_t now) {
+    uint8_t next = (event_head + 1) & (EVENT_RING_SIZE - 1);
+    if (next == event_tail) {
+        dropped++;
+        return;
+    }
+
+    matrix_event_t *ev = &event_ring[event_head];
+    ev->key = (uint8_t)((bit / MATRIX_MAX_COLS) * config->cols + bit % MATRIX_MAX_COLS);
+    ev->pressed = pressed;
+    ev->time_us = now;
+    __mem_fence_release();
+    event_head = next;
+}
+
+void matrix_scan(void) {
+    uint32_t start = time_us_32();
+
+    // Raw sample, one byte per row; a pressed key pulls its column low
+    uint64_t raw = 0;
+    for (uint8_t r = 0; r < config->rows; r++) {
+        select_row(config->row_pins[r]);
+        busy_wait_us_32(1);  // let the column lines settle
+        uint32_t cols = ~(gpio_get_all() >> config->col_base) & col_mask;
+        release_row(config->row_pins[r]);
+        raw |= (uint64_t)cols << (r * MATRIX_MAX_COLS);
+    }
+
+    // Vertical counter: counts scans each key has disagreed with its
+    // debounced state, and resets the moment it agrees again
+    uint64_t delta = raw ^ state;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+    uint64_t toggle = delta & ~(count0 | count1);
+    state ^= toggle;
+
+    // Only keys that changed cost anything beyond the word ops above
+    uint64_t now = time_us_64();
+    while (toggle) {
+        uint8_t bit = (uint8_t)__builtin_ctzll(toggle);
+        toggle &= toggle - 1;
+        push_event(bit, (state >> bit) & 1, now);
+    }
+
+    uint32_t took = time_us_32() - start;
+    if (took > scan_us_max) scan_us_max = took;
+}
+
+bool matrix_pop(matrix_event_t *ev) {
+    if (event_tail == event_head) return false;
+    __mem_fence_acquire();
+    *ev = event_ring[event_tail];
+    event_tail = (event_tail + 1) & (EVENT_RING_SIZE - 1);
+    return true;
+}
+
+bool matrix_any_pressed(void) {
+    return state != 0;
+}
+
+uint8_t matrix_key_count(void) {
+    return (uint8_t)(config->rows * config->cols);
+}
+
+uint32_t matrix_scan_us_max(void) {
+    return scan_us_max;
+}
+
+uint32_t matrix_dropped(void) {
+    return dropped;
+}
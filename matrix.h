@@ -0,0 +1,49 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Key-matrix scanner for macro pads (up to 8x8)
+//
+// Rows are driven low one at a time; columns are contiguous GPIOs with
+// pull-ups, so each row is read with a single register access. Debounce
+// state for every key lives in packed 64-bit bitmaps (one bit per key,
+// row r in byte r) and is updated with a handful of word-wide operations
+// per scan, independent of the key count.
+
+#define MATRIX_MAX_ROWS       8
+#define MATRIX_MAX_COLS       8
+#define MATRIX_SCAN_PERIOD_US 1000  // 1 kHz
+#define MATRIX_DEBOUNCE_SCANS 4     // a key must read the same for this many scans
+
+typedef struct {
+    uint8_t const *row_pins;  // driven low one at a time
+    uint8_t rows;
+    uint8_t col_base;         // first column GPIO; columns are col_base..col_base+cols-1
+    uint8_t cols;
+} matrix_config_t;
+
+typedef struct {
+    uint8_t key;       // row * cols + col
+    bool pressed;
+    uint64_t time_us;  // time of the scan that confirmed it
+} matrix_event_t;
+
+// cfg must stay valid while scanning
+void matrix_init(matrix_config_t const *cfg);
+
+// One full scan and debounce pass. Call every MATRIX_SCAN_PERIOD_US.
+void matrix_scan(void);
+
+// Next confirmed press/release. Returns false if there is none.
+bool matrix_pop(matrix_event_t *ev);
+
+bool matrix_any_pressed(void);
+uint8_t matrix_key_count(void);
+
+// Statistics
+uint32_t matrix_scan_us_max(void);  // slowest scan since init
+uint32_t matrix_dropped(void);      // events lost to a full ring
+
+#endif
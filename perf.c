@@ -0,0 +1,105 @@
+// Runtime performance counters - cheap core0 hooks plus a HID snapshot
+
+#include "perf.h"
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "hid_queue.h"
+#include "trigger.h"
+
+// GET_REPORT is answered from TinyUSB's HID buffer, so a counter appended
+// past it would be cut off without any error
+_Static_assert(sizeof(perf_report_t) <= CFG_TUD_HID_EP_BUFSIZE,
+               "perf_report_t no longer fits CFG_TUD_HID_EP_BUFSIZE");
+
+static uint32_t loop_hist[PERF_LOOP_BUCKETS];
+static uint32_t loop_max_us = 0;
+static uint64_t loop_start = 0;  // 0 after sleeping
+
+static uint32_t task_calls = 0;
+static uint32_t task_total_us = 0;
+static uint32_t task_max_us = 0;
+static uint32_t task_interval_max_us = 0;
+static uint64_t task_start = 0;  // 0 after sleeping
+
+static uint32_t burst_faces = 0;
+static uint32_t burst_us = 0;
+static uint32_t burst_last_faces = 0;
+static uint32_t burst_last_us = 0;
+
+static void loop_record(uint64_t now) {
+    uint32_t us = (uint32_t)(now - loop_start);
+    uint8_t bucket = 0;
+    while (bucket < PERF_LOOP_BUCKETS - 1 && us >= (1u << bucket)) bucket++;
+    loop_hist[bucket]++;
+    if (us > loop_max_us) loop_max_us = us;
+}
+
+void perf_loop_tick(void) {
+    uint64_t now = time_us_64();
+    if (loop_start) loop_record(now);
+    loop_start = now;
+}
+
+void perf_loop_idle(void) {
+    if (loop_start) loop_record(time_us_64());
+    loop_start = 0;
+    task_start = 0;
+}
+
+void perf_burst(uint32_t faces, uint32_t us) {
+    burst_faces += faces;
+    burst_us += us;
+    burst_last_faces = faces;
+    burst_last_us = us;
+}
+
+void perf_tud_task(void) {
+    uint64_t start = time_us_64();
+    if (task_start && start - task_start > task_interval_max_us) {
+        task_interval_max_us = (uint32_t)(start - task_start);
+    }
+    task_start = start;
+    tud_task();
+    uint32_t us = (uint32_t)(time_us_64() - start);
+
+    task_calls++;
+    task_total_us += us;
+    if (us > task_max_us) task_max_us = us;
+}
+
+uint32_t perf_task_interval_max_us(void) {
+    return task_interval_max_us;
+}
+
+uint16_t perf_get_report(uint8_t *buffer, uint16_t reqlen) {
+    perf_report_t r = {
+        .version          = PERF_REPORT_VERSION,
+        .length           = sizeof(perf_report_t),
+        .loop_buckets     = PERF_LOOP_BUCKETS,
+        .uptime_ms        = to_ms_since_boot(get_absolute_time()),
+        .loop_max_us      = loop_max_us,
+        .task_calls       = task_calls,
+        .task_total_us    = task_total_us,
+        .task_max_us      = task_max_us,
+        .reports_sent     = hid_queue_reports_sent(),
+        .reports_retried  = hid_queue_retries(),
+        .reports_dropped  = hid_queue_push_failures(),
+        .debounce_edges   = trigger_edge_count(),
+        .debounce_rejects = trigger_reject_count(),
+        .sequences        = hid_queue_sequences(),
+        .sequence_last_us = hid_queue_sequence_us(),
+        .sequence_max_us  = hid_queue_sequence_max_us(),
+        .task_interval_max_us = task_interval_max_us,
+        .burst_faces      = burst_faces,
+        .burst_us         = burst_us,
+        .burst_last_faces = burst_last_faces,
+        .burst_last_us    = burst_last_us,
+        .reports_discarded = hid_queue_discarded(),
+    };
+    memcpy(r.loop_hist, loop_hist, sizeof(loop_hist));
+
+    uint16_t len = sizeof(r) < reqlen ? sizeof(r) : reqlen;
+    memcpy(buffer, &r, len);
+    return len;
+}
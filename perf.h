@@ -0,0 +1,87 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Runtime performance counters, readable in production over HID
+//
+// The counters block is a feature report on the keyboard interface, so any
+// build can be queried through hidraw (HIDIOCGFEATURE) without CDC or the
+// debug firmware - see tools/lenny_stats. All fields are little-endian and
+// new fields are only ever appended; version changes if one is redefined.
+
+#define PERF_REPORT_VERSION 1
+#define PERF_LOOP_BUCKETS   8   // loop time histogram: <1, <2, <4 ... <64, >=64 us
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  length;            // sizeof(perf_report_t)
+    uint8_t  loop_buckets;      // PERF_LOOP_BUCKETS
+    uint8_t  reserved;
+    uint32_t uptime_ms;
+
+    // Core0 main loop: busy time per iteration (sleep excluded)
+    uint32_t loop_hist[PERF_LOOP_BUCKETS];
+    uint32_t loop_max_us;
+
+    // tud_task()
+    uint32_t task_calls;
+    uint32_t task_total_us;     // wraps; divide deltas by task_calls deltas
+    uint32_t task_max_us;
+
+    // Reports
+    uint32_t reports_sent;      // acknowledged by the host
+    uint32_t reports_retried;   // refused by the endpoint and sent again
+    uint32_t reports_dropped;   // refused by a full queue
+
+    // Trigger debounce
+    uint32_t debounce_edges;    // accepted level changes
+    uint32_t debounce_rejects;  // raw edges the filter swallowed
+
+    // Sequences
+    uint32_t sequences;
+    uint32_t sequence_last_us;
+    uint32_t sequence_max_us;
+
+    // Longest time from one tud_task() call to the next (sleep excluded) -
+    // the USB service interval the scheduler (sched.h) guarantees
+    uint32_t task_interval_max_us;
+
+    // Hold-to-repeat bursts (lenny_core.h): faces of finished bursts the
+    // host acknowledged in full, and the time they took - faces / time is
+    // the sustained rate
+    uint32_t burst_faces;
+    uint32_t burst_us;
+    uint32_t burst_last_faces;
+    uint32_t burst_last_us;
+    uint32_t reports_discarded; // queued but thrown away when the host went away
+} perf_report_t;
+
+// Feature report items for the keyboard's report descriptor: pass to
+// HID_QUEUE_REPORT_DESC_KEYBOARD(). The keyboard input report stays
+// without a report ID, so the boot protocol still works.
+#define PERF_HID_REPORT_DESC_FEATURE \
+    HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2 ), \
+    HID_USAGE        ( 0x01 ), \
+    HID_LOGICAL_MIN  ( 0x00 ), \
+    HID_LOGICAL_MAX_N( 0xff, 2 ), \
+    HID_REPORT_SIZE  ( 8 ), \
+    HID_REPORT_COUNT ( sizeof(perf_report_t) ), \
+    HID_FEATURE      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ),
+
+// Main loop hooks: tick at the top of every iteration, and call
+// perf_loop_idle() right before sleeping so sleep is not counted
+void perf_loop_tick(void);
+void perf_loop_idle(void);
+
+// A hold-to-repeat burst ended after typing faces in us
+void perf_burst(uint32_t faces, uint32_t us);
+
+// tud_task(), timed
+void perf_tud_task(void);
+uint32_t perf_task_interval_max_us(void);
+
+// Fill a GET_REPORT(Feature) request. Returns the length written.
+uint16_t perf_get_report(uint8_t *buffer, uint16_t reqlen);
+
+#endif
@@ -0,0 +1,126 @@
+// Core0 power management - clock scaling, WFE idle and suspend sleep
+
+#include "power.h"
+#include "trigger_filter.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/scb.h"
+#include "hardware/sync.h"
+
+#define LOOP_WINDOW_US 1000000
+
+static bool running_fast = true;
+static volatile bool suspended = false;
+static volatile bool remote_wakeup = false;
+
+static uint32_t loop_count = 0;
+static uint64_t loop_window_start = 0;
+static uint32_t loops_per_sec = 0;
+
+// Both PLLs stay locked, so switching is just the glitchless clk_sys mux -
+// no PLL relock on the way back up, and trigger latency is unchanged
+static void set_sys_source(bool fast) {
+    if (fast) {
+        clock_configure(clk_sys,
+                        CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+                        POWER_RUN_KHZ * 1000, POWER_RUN_KHZ * 1000);
+    } else {
+        clock_configure(clk_sys,
+                        CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                        POWER_IDLE_KHZ * 1000, POWER_IDLE_KHZ * 1000);
+    }
+    running_fast = fast;
+
+    // The PIO filter counts clk_sys cycles
+    trigger_filter_clock_changed();
+}
+
+void power_init(void) {
+    set_sys_clock_khz(POWER_RUN_KHZ, true);
+    running_fast = true;
+    loop_window_start = time_us_64();
+}
+
+void power_run(void) {
+    if (!running_fast) set_sys_source(true);
+}
+
+// Clocks left running in deep sleep: everything needed to execute from flash
+// on wake, plus the wake sources - USB (resume), PIO0 (trigger filter on
+// core1) and the timer (deadlines on both cores)
+static void gate_clocks(void) {
+    clocks_hw->sleep_en0 = CLOCKS_SLEEP_EN0_CLK_SYS_SRAM0_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM1_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM2_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_SRAM3_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS |
+                           CLOCKS_SLEEP_EN0_CLK_SYS_PLL_USB_BITS;
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_XIP_BITS |
+                           CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS;
+
+    // Gating only takes effect once both cores are asleep
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+}
+
+static void ungate_clocks(void) {
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+    clocks_hw->sleep_en0 = ~0u;
+    clocks_hw->sleep_en1 = ~0u;
+}
+
+void power_idle(absolute_time_t wake) {
+    if (running_fast) set_sys_source(false);
+
+    bool deep = suspended;
+    if (deep) gate_clocks();
+    best_effort_wfe_or_timeout(wake);
+    if (deep) ungate_clocks();
+}
+
+void power_suspend(bool remote_wakeup_en) {
+    remote_wakeup = remote_wakeup_en;
+    suspended = true;
+}
+
+void power_resume(void) {
+    suspended = false;
+}
+
+bool power_suspended(void) {
+    return suspended;
+}
+
+bool power_remote_wakeup_allowed(void) {
+    return remote_wakeup;
+}
+
+void power_loop_tick(void) {
+    loop_count++;
+
+    uint64_t now = time_us_64();
+    uint64_t elapsed = now - loop_window_start;
+    if (elapsed >= LOOP_WINDOW_US) {
+        loops_per_sec = (uint32_t)(((uint64_t)loop_count * 1000000) / elapsed);
+        loop_count = 0;
+        loop_window_start = now;
+    }
+}
+
+uint32_t power_loops_per_sec(void) {
+    return loops_per_sec;
+}
+
+uint32_t power_clock_khz(void) {
+    return running_fast ? POWER_RUN_KHZ : POWER_IDLE_KHZ;
+}
@@ -0,0 +1,41 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/time.h"
+
+// Core0 power management
+//
+// Full speed (125 MHz) only while a sequence is being typed; between
+// triggers clk_sys drops to 48 MHz from the USB PLL and the core sleeps in
+// WFE. While the host has the bus suspended, idle also gates every clock
+// not needed to wake up (USB, trigger PIO, timer) and enters deep sleep.
+
+#define POWER_RUN_KHZ   125000
+#define POWER_IDLE_KHZ  48000
+
+// Call once from core0 before the main loop. Leaves the clock at full speed.
+void power_init(void);
+
+// Switch clk_sys up before queueing a sequence. Cheap if already running.
+void power_run(void);
+
+// Sleep until the next event or wake, whichever comes first (pass
+// at_the_end_of_time for no deadline). Drops to the idle clock first and
+// uses deep sleep while suspended. Core1 wakes this with SEV.
+void power_idle(absolute_time_t wake);
+
+// Call from tud_suspend_cb() / tud_resume_cb()
+void power_suspend(bool remote_wakeup_en);
+void power_resume(void);
+
+bool power_suspended(void);
+bool power_remote_wakeup_allowed(void);
+
+// Idle-loop accounting: call once per main loop iteration
+void power_loop_tick(void);
+uint32_t power_loops_per_sec(void);  // over the last complete window
+uint32_t power_clock_khz(void);
+
+#endif
@@ -0,0 +1,113 @@
+// Core0 cooperative scheduler - posted, timed, wake and idle tasks around tud_task()
+
+#include "sched.h"
+#include "pico/stdlib.h"
+#include "perf.h"
+#include "power.h"
+
+static sched_task_t *tasks = NULL;
+static sched_task_t **tasks_end = &tasks;
+static sched_task_t *timers = NULL;    // earliest deadline first
+static uint64_t usb_serviced = 0;      // start of the last tud_task()
+
+void sched_add(sched_task_t *t) {
+    t->next = NULL;
+    *tasks_end = t;
+    tasks_end = &t->next;
+}
+
+void sched_post(sched_task_t *t) {
+    t->posted = true;
+}
+
+void sched_cancel(sched_task_t *t) {
+    if (!t->timed) return;
+    for (sched_task_t **p = &timers; *p; p = &(*p)->next_timer) {
+        if (*p == t) {
+            *p = t->next_timer;
+            break;
+        }
+    }
+    t->timed = false;
+}
+
+void sched_at(sched_task_t *t, absolute_time_t when) {
+    sched_cancel(t);
+    t->due = when;
+    t->timed = true;
+
+    // Behind every timer due no later, so equal deadlines run in arming order
+    sched_task_t **p = &timers;
+    while (*p && to_us_since_boot((*p)->due) <= to_us_since_boot(when)) p = &(*p)->next_timer;
+    t->next_timer = *p;
+    *p = t;
+}
+
+sched_task_t const *sched_tasks(void) {
+    return tasks;
+}
+
+static void service_usb(void) {
+    usb_serviced = time_us_64();
+    perf_tud_task();
+}
+
+static void run_task(sched_task_t *t) {
+    uint64_t start = time_us_64();
+    t->run();
+    uint32_t us = (uint32_t)(time_us_64() - start);
+
+    t->runs++;
+    if (us > t->max_us) t->max_us = us;
+}
+
+// Move every due timer over to posted
+static void expire_timers(void) {
+    uint64_t now = time_us_64();
+    while (timers && to_us_since_boot(timers->due) <= now) {
+        sched_task_t *t = timers;
+        timers = t->next_timer;
+        t->timed = false;
+        t->posted = true;
+    }
+}
+
+static bool any_posted(void) {
+    for (sched_task_t *t = tasks; t; t = t->next) {
+        if (t->posted) return true;
+    }
+    return false;
+}
+
+void sched_run(void) {
+    while (true) {
+        perf_loop_tick();
+        service_usb();
+        power_loop_tick();
+        expire_timers();
+
+        for (sched_task_t *t = tasks; t; t = t->next) {
+            if (!t->posted && !t->on_wake) continue;
+            if (time_us_64() - usb_serviced >= SCHED_USB_SLICE_US) service_usb();
+            // Cleared first, so the task can post itself to run again
+            t->posted = false;
+            run_task(t);
+        }
+
+        if (any_posted()) continue;
+
+        // Nothing else to do - background work, which may post itself to
+        // keep the scheduler awake
+        for (sched_task_t *t = tasks; t; t = t->next) {
+            if (!t->on_idle) continue;
+            if (time_us_64() - usb_serviced >= SCHED_USB_SLICE_US) service_usb();
+            run_task(t);
+        }
+        if (any_posted()) continue;
+
+        // Drop the clock and sleep until the next interrupt, a message from
+        // core1 or the next timer
+        perf_loop_idle();
+        power_idle(timers ? timers->due : at_the_end_of_time);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pico/time.h"
+
+// Core0 cooperative scheduler - run-to-completion tasks around tud_task()
+//
+// A task is a function that does a bounded step of work and returns; none
+// of them sleeps or waits. It runs when:
+//   - posted (sched_post()) - from a task, a TinyUSB callback or an
+//     interrupt. A task that has more to do posts itself, which is how it
+//     yields: everything else gets its turn before it runs again.
+//   - its timer is due (sched_at()). Armed timers are kept in deadline
+//     order, so finding the next one is a look at the head.
+//   - on every pass, if it was added with on_wake set - for events that
+//     only arrive as a wake-up with no callback to post from, such as a
+//     message from core1 (input.c) after its SEV.
+//   - right before the scheduler would sleep, if added with on_idle set -
+//     for background work such as sending log output.
+// Tasks run in the order they were added.
+//
+// tud_task() runs at the top of every pass and again before any task that
+// starts more than SCHED_USB_SLICE_US after the last call, so the longest
+// interval between two calls while awake is SCHED_USB_SLICE_US plus the
+// longest single task step. perf.h measures that interval; it is in the
+// perf report and lenny_stats. With nothing posted the scheduler drops the
+// clock and sleeps until the next interrupt, core1 event or timer.
+
+#define SCHED_USB_SLICE_US 100
+
+typedef struct sched_task {
+    void (*run)(void);
+    char const *name;
+    bool on_wake;                   // also run on every pass
+    bool on_idle;                   // also run before sleeping
+
+    // Scheduler state
+    volatile bool posted;
+    bool timed;
+    absolute_time_t due;
+    struct sched_task *next;        // in the order added
+    struct sched_task *next_timer;  // armed timers, earliest first
+
+    // Statistics
+    uint32_t runs;
+    uint32_t max_us;                // longest single step
+} sched_task_t;
+
+// Register a task. t must stay valid forever; call before sched_run().
+void sched_add(sched_task_t *t);
+
+// Run t on the next pass. Safe from interrupts and TinyUSB callbacks.
+void sched_post(sched_task_t *t);
+
+// Run t once when is reached, replacing a timer already armed for it.
+// Core0 task context only.
+void sched_at(sched_task_t *t, absolute_time_t when);
+void sched_cancel(sched_task_t *t);
+
+// Main loop. Never returns.
+void sched_run(void);
+
+// Every registered task, in the order added (follow ->next)
+sched_task_t const *sched_tasks(void);
+
+#endif
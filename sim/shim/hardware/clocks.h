@@ -0,0 +1,44 @@
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). Clock changes
+// are recorded but do not change virtual time.
+
+#include "pico/types.h"
+
+enum clock_index { clk_gpout0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc };
+
+#define CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX 0x1
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS  0x0
+#define CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB  0x1
+
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SRAM3_BITS     (1u << 31)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SRAM2_BITS     (1u << 30)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SRAM1_BITS     (1u << 29)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_SRAM0_BITS     (1u << 28)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PLL_USB_BITS   (1u << 13)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS      (1u << 10)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_PADS_BITS      (1u << 9)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_IO_BITS        (1u << 7)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_BUSFABRIC_BITS (1u << 4)
+#define CLOCKS_SLEEP_EN0_CLK_SYS_CLOCKS_BITS    (1u << 0)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_XOSC_BITS      (1u << 14)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_XIP_BITS       (1u << 13)
+#define CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS   (1u << 11)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS   (1u << 10)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS     (1u << 5)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SRAM5_BITS     (1u << 1)
+#define CLOCKS_SLEEP_EN1_CLK_SYS_SRAM4_BITS     (1u << 0)
+
+typedef struct {
+    volatile uint32_t sleep_en0;
+    volatile uint32_t sleep_en1;
+} clocks_hw_t;
+
+extern clocks_hw_t *clocks_hw;
+
+bool clock_configure(enum clock_index clk, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq);
+uint32_t clock_get_hz(enum clock_index clk);
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SIM_HARDWARE_FLASH_H
+#define SIM_HARDWARE_FLASH_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). Flash is a
+// RAM array mapped at XIP_BASE; erase and program take the virtual time a
+// W25Q16 typically takes and keep NOR semantics (program only clears bits).
+// Until erased it reads as zeros.
+
+#include "pico/types.h"
+
+#define FLASH_PAGE_SIZE        256u
+#define FLASH_SECTOR_SIZE      4096u
+#define FLASH_BLOCK_SIZE       65536u
+#define PICO_FLASH_SIZE_BYTES  (2 * 1024 * 1024)
+
+extern uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)sim_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, uint8_t const *data, size_t count);
+
+#endif
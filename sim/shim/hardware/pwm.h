@@ -0,0 +1,15 @@
+#ifndef SIM_HARDWARE_PWM_H
+#define SIM_HARDWARE_PWM_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). The LED output
+// is not modelled; these only have to compile and cost nothing.
+
+#include "pico/types.h"
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1) & 7; }
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SIM_HARDWARE_STRUCTS_SCB_H
+#define SIM_HARDWARE_STRUCTS_SCB_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h)
+
+#include "pico/types.h"
+
+#define M0PLUS_SCR_SLEEPDEEP_BITS 0x00000004
+
+typedef struct {
+    volatile uint32_t scr;
+} armv6m_scb_hw_t;
+
+extern armv6m_scb_hw_t *scb_hw;
+
+#endif
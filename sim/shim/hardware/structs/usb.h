@@ -0,0 +1,14 @@
+#ifndef SIM_HARDWARE_STRUCTS_USB_H
+#define SIM_HARDWARE_STRUCTS_USB_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h)
+
+#include "pico/types.h"
+
+typedef struct {
+    volatile uint8_t setup_packet[8];
+} usb_device_dpram_t;
+
+extern usb_device_dpram_t *usb_dpram;
+
+#endif
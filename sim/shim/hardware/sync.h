@@ -0,0 +1,21 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). The two cores
+// are coroutines on one host thread, so compiler barriers are enough.
+
+#include "pico/types.h"
+
+static inline void __compiler_memory_barrier(void) { __asm__ volatile ("" ::: "memory"); }
+static inline void __mem_fence_release(void) { __compiler_memory_barrier(); }
+static inline void __mem_fence_acquire(void) { __compiler_memory_barrier(); }
+static inline void __dmb(void) { __compiler_memory_barrier(); }
+
+void __sev(void);
+void __wfe(void);
+void __wfi(void);
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif
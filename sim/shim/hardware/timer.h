@@ -0,0 +1,15 @@
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h)
+
+#include "pico/types.h"
+
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+
+// Busy waits cost virtual time like sleeps, but never wake early
+void busy_wait_us_32(uint32_t us);
+
+#endif
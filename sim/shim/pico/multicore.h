@@ -0,0 +1,17 @@
+#ifndef SIM_PICO_MULTICORE_H
+#define SIM_PICO_MULTICORE_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). Core1 runs as a
+// second coroutine on the virtual clock.
+
+#include "pico/types.h"
+
+void multicore_launch_core1(void (*entry)(void));
+
+bool multicore_fifo_rvalid(void);
+bool multicore_fifo_wready(void);
+void multicore_fifo_push_blocking(uint32_t data);
+uint32_t multicore_fifo_pop_blocking(void);
+void multicore_fifo_drain(void);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h)
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+static inline void tight_loop_contents(void) {}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h). Every call that
+// waits hands the virtual clock to the scheduler; none of them block.
+
+#include "pico/types.h"
+#include "hardware/timer.h"
+
+#define at_the_end_of_time ((absolute_time_t)UINT64_MAX)
+
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + (uint64_t)ms * 1000; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + (uint64_t)ms * 1000; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void sleep_until(absolute_time_t t);
+
+// Returns true if the timeout was reached, false if woken by an event
+bool best_effort_wfe_or_timeout(absolute_time_t timeout);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SIM_PICO_TYPES_H
+#define SIM_PICO_TYPES_H
+
+// Host simulation stand-in for the Pico SDK (see sim/sim.h)
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+// Everything is in RAM here (pico/platform.h)
+#define __not_in_flash_func(f) f
+typedef uint64_t absolute_time_t;
+
+#endif
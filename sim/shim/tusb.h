@@ -0,0 +1,156 @@
+#ifndef SIM_TUSB_H
+#define SIM_TUSB_H
+
+// Host simulation stand-in for TinyUSB (see sim/sim.h)
+//
+// Models one full-speed host: enumeration after a fixed delay (replaying
+// the descriptor requests of a chosen host OS), one HID IN report per 1 ms
+// frame, completion callbacks from tud_task(), bus suspend and resume, a
+// CDC port backed by the scenario and the CDC log, and macro uploads on the
+// second HID interface (instance 1).
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/types.h"
+
+//--------------------------------------------------------------------+
+// Descriptors - only the shapes the firmware builds; contents are not parsed
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t  bDeviceClass;
+    uint8_t  bDeviceSubClass;
+    uint8_t  bDeviceProtocol;
+    uint8_t  bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t  iManufacturer;
+    uint8_t  iProduct;
+    uint8_t  iSerialNumber;
+    uint8_t  bNumConfigurations;
+} tusb_desc_device_t;
+
+enum {
+    TUSB_DESC_DEVICE        = 0x01,
+    TUSB_DESC_CONFIGURATION = 0x02,
+    TUSB_DESC_STRING        = 0x03,
+};
+
+enum { TUSB_CLASS_MISC = 0xEF };
+enum { MISC_SUBCLASS_COMMON = 2 };
+enum { MISC_PROTOCOL_IAD = 1 };
+
+enum {
+    HID_ITF_PROTOCOL_NONE     = 0,
+    HID_ITF_PROTOCOL_KEYBOARD = 1,
+    HID_ITF_PROTOCOL_MOUSE    = 2,
+};
+
+typedef enum {
+    HID_REPORT_TYPE_INVALID,
+    HID_REPORT_TYPE_INPUT,
+    HID_REPORT_TYPE_OUTPUT,
+    HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+enum { HID_DESC_TYPE_REPORT = 0x22 };
+
+typedef enum {
+    HID_PROTOCOL_BOOT   = 0,
+    HID_PROTOCOL_REPORT = 1,
+} hid_protocol_type_t;
+
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP 0x20
+
+#define CFG_TUD_ENDPOINT0_SIZE 64
+#define CFG_TUD_HID_EP_BUFSIZE 128 // as tusb_config_hid.h and tusb_config_debug.h
+#define CFG_TUD_CDC            1   // every simulated image gets the CDC port
+
+typedef struct {
+    uint32_t bit_rate;
+    uint8_t  stop_bits;
+    uint8_t  parity;
+    uint8_t  data_bits;
+} cdc_line_coding_t;
+
+#define TUD_CONFIG_DESC_LEN     9
+#define TUD_HID_DESC_LEN        25
+#define TUD_HID_INOUT_DESC_LEN  32
+#define TUD_CDC_DESC_LEN    66
+
+// Report descriptor items - only those the firmware uses
+#define HID_USAGE_PAGE_DESKTOP     0x01
+#define HID_USAGE_PAGE_KEYBOARD    0x07
+#define HID_USAGE_PAGE_LED         0x08
+#define HID_USAGE_PAGE_VENDOR      0xFF00
+#define HID_USAGE_DESKTOP_KEYBOARD 0x06
+#define HID_COLLECTION_APPLICATION 0x01
+enum { HID_DATA = 0, HID_CONSTANT = 1, HID_VARIABLE = 2, HID_ABSOLUTE = 0 };
+#define HID_USAGE_PAGE(x)       0x05, (uint8_t)(x)
+#define HID_USAGE_PAGE_N(x, n)  0x06, (uint8_t)(x), (uint8_t)((x) >> 8)
+#define HID_USAGE(x)            0x09, (uint8_t)(x)
+#define HID_USAGE_MIN(x)        0x19, (uint8_t)(x)
+#define HID_USAGE_MAX(x)        0x29, (uint8_t)(x)
+#define HID_LOGICAL_MIN(x)      0x15, (uint8_t)(x)
+#define HID_LOGICAL_MAX(x)      0x25, (uint8_t)(x)
+#define HID_LOGICAL_MAX_N(x, n) 0x26, (uint8_t)(x), (uint8_t)((x) >> 8)
+#define HID_REPORT_SIZE(x)      0x75, (uint8_t)(x)
+#define HID_REPORT_COUNT(x)     0x95, (uint8_t)(x)
+#define HID_INPUT(x)            0x81, (uint8_t)(x)
+#define HID_OUTPUT(x)           0x91, (uint8_t)(x)
+#define HID_FEATURE(x)          0xB1, (uint8_t)(x)
+#define HID_COLLECTION(x)       0xA1, (uint8_t)(x)
+#define HID_COLLECTION_END      0xC0
+
+#define TUD_HID_REPORT_DESC_KEYBOARD(...) 0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, __VA_ARGS__ 0xC0
+#define TUD_CONFIG_DESCRIPTOR(...)        0x09, TUSB_DESC_CONFIGURATION, 0, 0, 0, 0, 0, 0, 0
+#define TUD_HID_DESCRIPTOR(...)           0x09, 0x04, 0, 0, 0, 0, 0, 0, 0
+#define TUD_HID_INOUT_DESCRIPTOR(...)     0x09, 0x04, 0, 0, 0, 0, 0, 0, 0
+#define TUD_HID_REPORT_DESC_GENERIC_INOUT(n, ...) 0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01, 0xC0
+#define TUD_CDC_DESCRIPTOR(...)           0x08, 0x0B, 0, 0, 0, 0, 0, 0
+
+//--------------------------------------------------------------------+
+// Device API
+//--------------------------------------------------------------------+
+
+bool tusb_init(void);
+void tud_task(void);
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+
+bool tud_hid_ready(void);
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t const keycode[6]);
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len);
+
+bool tud_cdc_connected(void);
+uint32_t tud_cdc_available(void);
+int32_t tud_cdc_read_char(void);
+bool tud_cdc_peek(uint8_t *chr);
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_str(char const *str);
+uint32_t tud_cdc_write_flush(void);
+uint32_t tud_cdc_write_available(void);
+
+// Callbacks implemented by the firmware (the optional ones have weak
+// defaults in the simulator, as in TinyUSB)
+uint8_t const *tud_descriptor_device_cb(void);
+uint8_t const *tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance);
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize);
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len);
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol);
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding);
+void tud_cdc_rx_cb(uint8_t itf);
+
+#endif
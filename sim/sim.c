@@ -0,0 +1,240 @@
+// Simulation scheduler - virtual clock, core coroutines, interrupts, SIO
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include "sim.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+#define CORE_STACK_SIZE (256 * 1024)
+#define MAX_IRQS        4096
+#define FIFO_DEPTH      8
+
+typedef struct {
+    ucontext_t ctx;
+    void (*entry)(void);
+    bool started;
+    bool finished;
+    uint64_t wake_at;
+    bool wake_on_event;
+    bool event;         // the core's event register (SEV / interrupt)
+} core_t;
+
+typedef struct {
+    uint64_t at;
+    int core;
+    sim_irq_fn_t fn;
+    void *arg;
+} irq_t;
+
+static ucontext_t scheduler;
+static core_t cores[2];
+static int current = -1;
+static uint64_t now_us = 0;
+
+// Pending interrupts, kept sorted by time (stable for equal times)
+static irq_t irqs[MAX_IRQS];
+static size_t irq_count = 0;
+
+// Inter-core FIFOs: fifo[n] is read by core n
+static uint32_t fifo[2][FIFO_DEPTH];
+static uint8_t fifo_len[2];
+
+//--------------------------------------------------------------------+
+// Scheduler
+//--------------------------------------------------------------------+
+
+static void core_trampoline(void) {
+    cores[current].entry();
+    cores[current].finished = true;
+    setcontext(&scheduler);
+}
+
+static void start_core(int n, void (*entry)(void)) {
+    core_t *c = &cores[n];
+    getcontext(&c->ctx);
+    c->ctx.uc_stack.ss_sp = malloc(CORE_STACK_SIZE);
+    c->ctx.uc_stack.ss_size = CORE_STACK_SIZE;
+    c->ctx.uc_link = &scheduler;
+    makecontext(&c->ctx, core_trampoline, 0);
+    c->entry = entry;
+    c->started = true;
+    c->wake_at = now_us;
+    c->wake_on_event = false;
+}
+
+void sim_boot(void (*entry)(void)) {
+    start_core(0, entry);
+}
+
+static bool runnable(core_t const *c) {
+    if (!c->started || c->finished) return false;
+    return now_us >= c->wake_at || (c->wake_on_event && c->event);
+}
+
+static void resume(int n) {
+    core_t *c = &cores[n];
+    if (c->wake_on_event && c->event && now_us < c->wake_at) c->event = false;
+    current = n;
+    swapcontext(&scheduler, &c->ctx);
+    current = -1;
+}
+
+void sim_run(uint64_t end_us) {
+    while (true) {
+        // Cores first, in a fixed order, so the interleaving is repeatable
+        if (runnable(&cores[0])) { resume(0); continue; }
+        if (runnable(&cores[1])) { resume(1); continue; }
+
+        uint64_t next = SIM_FOREVER;
+        if (irq_count) next = irqs[0].at;
+        for (int n = 0; n < 2; n++) {
+            if (cores[n].started && !cores[n].finished && cores[n].wake_at < next) next = cores[n].wake_at;
+        }
+        if (next > end_us) break;
+        if (next > now_us) now_us = next;
+
+        // Deliver every interrupt that is due
+        while (irq_count && irqs[0].at <= now_us) {
+            irq_t irq = irqs[0];
+            irq_count--;
+            for (size_t i = 0; i < irq_count; i++) irqs[i] = irqs[i + 1];
+
+            current = irq.core;
+            irq.fn(irq.arg);
+            current = -1;
+            cores[irq.core].event = true;
+        }
+    }
+    now_us = end_us;
+}
+
+uint64_t sim_now(void) {
+    return now_us;
+}
+
+int sim_current_core(void) {
+    return current;
+}
+
+bool sim_wait(uint64_t until_us, bool wake_on_event) {
+    core_t *c = &cores[current];
+
+    // WFE returns at once if the event register is already set
+    if (wake_on_event && c->event) {
+        c->event = false;
+        return now_us >= until_us;
+    }
+
+    int n = current;
+    c->wake_at = until_us;
+    c->wake_on_event = wake_on_event;
+    swapcontext(&c->ctx, &scheduler);
+    current = n;
+    return now_us >= until_us;
+}
+
+void sim_irq(uint64_t at_us, int core, sim_irq_fn_t fn, void *arg) {
+    if (irq_count == MAX_IRQS) {
+        fprintf(stderr, "sim: interrupt queue full\n");
+        exit(1);
+    }
+    size_t i = irq_count++;
+    while (i > 0 && irqs[i - 1].at > at_us) {
+        irqs[i] = irqs[i - 1];
+        i--;
+    }
+    irqs[i] = (irq_t){ at_us, core, fn, arg };
+}
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+void busy_wait_us_32(uint32_t us) {
+    sim_wait(now_us + us, false);
+}
+
+void sleep_us(uint64_t us) {
+    sim_wait(now_us + us, false);
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_wait(now_us + (uint64_t)ms * 1000, false);
+}
+
+void sleep_until(absolute_time_t t) {
+    sim_wait(t, false);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout) {
+    return sim_wait(timeout, true);
+}
+
+//--------------------------------------------------------------------+
+// Events and interrupts
+//--------------------------------------------------------------------+
+
+void __sev(void) {
+    cores[0].event = true;
+    cores[1].event = true;
+}
+
+void __wfe(void) {
+    sim_wait(SIM_FOREVER, true);
+}
+
+void __wfi(void) {
+    sim_wait(SIM_FOREVER, true);
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    return 0;  // interrupts only run between coroutine switches
+}
+
+void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+//--------------------------------------------------------------------+
+// Multicore
+//--------------------------------------------------------------------+
+
+void multicore_launch_core1(void (*entry)(void)) {
+    start_core(1, entry);
+}
+
+bool multicore_fifo_rvalid(void) {
+    return fifo_len[current] != 0;
+}
+
+bool multicore_fifo_wready(void) {
+    return fifo_len[current ^ 1] < FIFO_DEPTH;
+}
+
+void multicore_fifo_push_blocking(uint32_t data) {
+    int other = current ^ 1;
+    while (fifo_len[other] == FIFO_DEPTH) sim_wait(SIM_FOREVER, true);
+    fifo[other][fifo_len[other]++] = data;
+    __sev();
+}
+
+uint32_t multicore_fifo_pop_blocking(void) {
+    int self = current;
+    while (fifo_len[self] == 0) sim_wait(SIM_FOREVER, true);
+
+    uint32_t data = fifo[self][0];
+    fifo_len[self]--;
+    for (uint8_t i = 0; i < fifo_len[self]; i++) fifo[self][i] = fifo[self][i + 1];
+    __sev();
+    return data;
+}
+
+void multicore_fifo_drain(void) {
+    fifo_len[current] = 0;
+}
@@ -0,0 +1,134 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host simulation of the firmware
+//
+// The unmodified firmware sources are compiled against the stand-in Pico
+// SDK and TinyUSB headers in sim/shim. Both cores run as coroutines on one
+// host thread and a deterministic virtual clock: time only moves when a core
+// waits (sleep, WFE, busy wait, tud_task), and interrupts are delivered at
+// exact virtual times. The same scenario always produces the same log.
+
+#define SIM_FOREVER UINT64_MAX
+
+//--------------------------------------------------------------------+
+// Scheduler (sim.c)
+//--------------------------------------------------------------------+
+
+typedef void (*sim_irq_fn_t)(void *arg);
+
+// Start core0 at entry (the firmware's main) at virtual time 0
+void sim_boot(void (*entry)(void));
+
+// Run both cores until virtual time end_us
+void sim_run(uint64_t end_us);
+
+uint64_t sim_now(void);
+int sim_current_core(void);
+
+// Called from a core: give up the CPU until until_us, or until an event
+// (SEV or interrupt) if wake_on_event. Returns true if until_us was reached.
+bool sim_wait(uint64_t until_us, bool wake_on_event);
+
+// Raise an interrupt on core at virtual time at_us: fn runs in interrupt
+// context on that core and wakes it from WFE
+void sim_irq(uint64_t at_us, int core, sim_irq_fn_t fn, void *arg);
+
+//--------------------------------------------------------------------+
+// GPIO (sim_hw.c)
+//--------------------------------------------------------------------+
+
+// Scripted input level for a pin from time at_us on (pins idle high, as
+// with the firmware's pull-ups). Transitions may be added in any order
+// before sim_boot().
+void sim_gpio_wave(uint8_t pin, uint64_t at_us, bool level);
+
+// Level of the scripted waveform at a time, and the first transition after
+bool sim_gpio_wave_level(uint8_t pin, uint64_t at_us);
+uint64_t sim_gpio_wave_next(uint8_t pin, uint64_t after_us);
+
+// Matrix key between a row and a column pin, closed or opened at at_us. A
+// closed key pulls the column low while its row is driven low.
+void sim_gpio_switch(uint8_t row, uint8_t col, uint64_t at_us, bool closed);
+
+//--------------------------------------------------------------------+
+// USB host (sim_hw.c)
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint64_t time_us;   // when the host received it
+    uint8_t modifier;
+    uint8_t keycode[6]; // keys down, in usage order for an NKRO report
+} sim_hid_record_t;
+
+// Host OS whose enumeration is replayed through the descriptor callbacks
+// (and which then sets the keyboard LEDs). SIM_HOST_NONE mounts silently.
+typedef enum {
+    SIM_HOST_NONE,
+    SIM_HOST_LINUX,
+    SIM_HOST_WINDOWS,
+    SIM_HOST_MACOS,
+} sim_host_t;
+
+void sim_usb_set_host(sim_host_t os);
+void sim_usb_set_frame_us(uint32_t us);     // host poll interval, default 1000
+void sim_usb_suspend(uint64_t at_us);
+void sim_usb_resume(uint64_t at_us);
+void sim_cdc_input(uint64_t at_us, char const *text);
+void sim_cdc_line_coding(uint64_t at_us, uint32_t bit_rate);  // host (re)opens the port
+
+// GET_REPORT(Feature) on the HID interface, answered from tud_task() like a
+// control request
+typedef struct {
+    uint64_t time_us;
+    uint16_t len;
+    uint8_t data[128];  // CFG_TUD_HID_EP_BUFSIZE
+} sim_feature_record_t;
+
+void sim_hid_get_feature(uint64_t at_us);
+
+// SET_PROTOCOL on the keyboard interface; every mount starts in the report
+// protocol
+void sim_hid_set_protocol(uint64_t at_us, bool boot);
+size_t sim_feature_count(void);
+sim_feature_record_t const *sim_feature_log(void);
+
+size_t sim_hid_count(void);
+sim_hid_record_t const *sim_hid_log(void);
+
+// Reports to HID instance 1 (the upload interface). The host sends them in
+// order, one per frame and none before its at_us, each once the previous
+// callback returned; after one with wait_reply it holds the rest until the
+// device sends an IN report.
+void sim_hid_out(uint64_t at_us, uint8_t const report[64], bool wait_reply);
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t data[64];
+} sim_hid_in_record_t;
+
+size_t sim_hid_in_count(void);
+sim_hid_in_record_t const *sim_hid_in_log(void);
+
+// CDC bytes refused because the TX FIFO was full, and bulk packets sent
+uint64_t sim_cdc_dropped(void);
+uint64_t sim_cdc_packets(void);
+
+//--------------------------------------------------------------------+
+// Trigger filter (trigger_filter_sim.c)
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint64_t time_us;   // when the filter reported it
+    uint8_t pin;
+    bool pressed;
+} sim_filter_record_t;
+
+size_t sim_filter_count(void);
+sim_filter_record_t const *sim_filter_log(void);
+
+#endif
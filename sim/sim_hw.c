@@ -0,0 +1,788 @@
+// Simulated peripherals - GPIO waveforms, clocks, USB host and CDC port
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "tusb.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/usb.h"
+#include "hardware/flash.h"
+#include "hid_queue.h"
+
+#define MAX_TRANSITIONS 4096
+#define MAX_SWITCHES    1024
+#define MAX_HID_RECORDS 65536
+#define CDC_RX_SIZE     1024
+#define MAX_FEATURE_RECORDS 64
+#define MAX_OUT_REPORTS 2048
+#define MAX_IN_RECORDS  256
+
+#define USB_ENUM_US        50000  // tusb_init() to mounted
+#define USB_RESUME_US      20000  // remote wakeup to resumed
+#define USB_TASK_US        1      // cost of one tud_task() call
+#define USB_LED_US         20000  // mounted to the host setting the keyboard LEDs
+
+#define FLASH_SECTOR_ERASE_US  45000   // W25Q16 typical
+#define FLASH_BLOCK_ERASE_US   150000
+#define FLASH_PAGE_PROGRAM_US  400
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint64_t at;
+    uint8_t pin;
+    bool level;
+} transition_t;
+
+typedef struct {
+    uint64_t at;
+    uint8_t row;
+    uint8_t col;
+    bool closed;
+} switch_t;
+
+static transition_t waves[MAX_TRANSITIONS];
+static size_t wave_count = 0;
+static switch_t switches[MAX_SWITCHES];
+static size_t switch_count = 0;
+
+static bool pin_out[NUM_BANK0_GPIOS];
+static bool pin_value[NUM_BANK0_GPIOS];
+
+void sim_gpio_wave(uint8_t pin, uint64_t at_us, bool level) {
+    if (wave_count == MAX_TRANSITIONS) {
+        fprintf(stderr, "sim: too many GPIO transitions\n");
+        exit(1);
+    }
+    size_t i = wave_count++;
+    while (i > 0 && waves[i - 1].at > at_us) {
+        waves[i] = waves[i - 1];
+        i--;
+    }
+    waves[i] = (transition_t){ at_us, pin, level };
+}
+
+bool sim_gpio_wave_level(uint8_t pin, uint64_t at_us) {
+    bool level = true;  // pull-up
+    for (size_t i = 0; i < wave_count && waves[i].at <= at_us; i++) {
+        if (waves[i].pin == pin) level = waves[i].level;
+    }
+    return level;
+}
+
+uint64_t sim_gpio_wave_next(uint8_t pin, uint64_t after_us) {
+    for (size_t i = 0; i < wave_count; i++) {
+        if (waves[i].pin == pin && waves[i].at > after_us) return waves[i].at;
+    }
+    return SIM_FOREVER;
+}
+
+void sim_gpio_switch(uint8_t row, uint8_t col, uint64_t at_us, bool closed) {
+    if (switch_count == MAX_SWITCHES) {
+        fprintf(stderr, "sim: too many switch events\n");
+        exit(1);
+    }
+    size_t i = switch_count++;
+    while (i > 0 && switches[i - 1].at > at_us) {
+        switches[i] = switches[i - 1];
+        i--;
+    }
+    switches[i] = (switch_t){ at_us, row, col, closed };
+}
+
+static bool switch_closed(uint8_t row, uint8_t col, uint64_t at_us) {
+    bool closed = false;
+    for (size_t i = 0; i < switch_count && switches[i].at <= at_us; i++) {
+        if (switches[i].row == row && switches[i].col == col) closed = switches[i].closed;
+    }
+    return closed;
+}
+
+void gpio_init(uint gpio) {
+    pin_out[gpio] = false;
+    pin_value[gpio] = false;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    pin_out[gpio] = out;
+}
+
+void gpio_put(uint gpio, bool value) {
+    pin_value[gpio] = value;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio; (void)fn;
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+    (void)slice_num; (void)wrap;
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    (void)gpio; (void)level;
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+    (void)slice_num; (void)enabled;
+}
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;  // every undriven input idles high
+}
+
+bool gpio_get(uint gpio) {
+    if (pin_out[gpio]) return pin_value[gpio];
+
+    uint64_t now = sim_now();
+    if (!sim_gpio_wave_level((uint8_t)gpio, now)) return false;
+
+    // A closed matrix key shorts this column to a row driven low
+    for (uint row = 0; row < NUM_BANK0_GPIOS; row++) {
+        if (pin_out[row] && !pin_value[row] && switch_closed((uint8_t)row, (uint8_t)gpio, now)) return false;
+    }
+    return true;
+}
+
+uint32_t gpio_get_all(void) {
+    uint32_t all = 0;
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (gpio_get(gpio)) all |= 1u << gpio;
+    }
+    return all;
+}
+
+// Edge interrupts: the next matching transition of the waveform is
+// scheduled while enabled. Disabling leaves the pending interrupt in the
+// scheduler, so it checks that it is still the one armed.
+typedef struct {
+    uint8_t pin;
+    uint32_t mask;
+    int core;
+    uint64_t armed_at;  // SIM_FOREVER if nothing is scheduled
+} gpio_irq_t;
+
+static gpio_irq_t gpio_irqs[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_callback = NULL;
+
+static void arm_gpio_irq(gpio_irq_t *irq, uint64_t after_us);
+
+static void on_gpio_irq(void *arg) {
+    gpio_irq_t *irq = arg;
+    uint64_t now = sim_now();
+    if (irq->mask == 0 || irq->armed_at != now) return;  // disabled or re-armed since
+
+    bool level = sim_gpio_wave_level(irq->pin, now);
+    irq->armed_at = SIM_FOREVER;
+    if (gpio_callback) gpio_callback(irq->pin, level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+    if (irq->mask != 0 && irq->armed_at == SIM_FOREVER) arm_gpio_irq(irq, now);
+}
+
+static void arm_gpio_irq(gpio_irq_t *irq, uint64_t after_us) {
+    irq->armed_at = SIM_FOREVER;
+    bool level = sim_gpio_wave_level(irq->pin, after_us);
+    for (uint64_t t = sim_gpio_wave_next(irq->pin, after_us); t != SIM_FOREVER;
+         t = sim_gpio_wave_next(irq->pin, t)) {
+        bool next = sim_gpio_wave_level(irq->pin, t);
+        if (next != level && (irq->mask & (next ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL))) {
+            irq->armed_at = t;
+            sim_irq(t, irq->core, on_gpio_irq, irq);
+            return;
+        }
+        level = next;
+    }
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    gpio_irq_t *irq = &gpio_irqs[gpio];
+    uint32_t mask = enabled ? (irq->mask | event_mask) : (irq->mask & ~event_mask);
+    mask &= GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE;
+
+    irq->pin = (uint8_t)gpio;
+    irq->core = sim_current_core();
+    if (mask == irq->mask) return;
+    irq->mask = mask;
+    if (mask) {
+        arm_gpio_irq(irq, sim_now());  // edges before enabling are acknowledged
+    } else {
+        irq->armed_at = SIM_FOREVER;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback) {
+    gpio_callback = callback;
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+}
+
+//--------------------------------------------------------------------+
+// Clocks
+//--------------------------------------------------------------------+
+
+static clocks_hw_t clocks_regs;
+static armv6m_scb_hw_t scb_regs;
+clocks_hw_t *clocks_hw = &clocks_regs;
+armv6m_scb_hw_t *scb_hw = &scb_regs;
+
+static usb_device_dpram_t usb_regs;
+usb_device_dpram_t *usb_dpram = &usb_regs;
+
+static uint32_t sys_hz = 125000000;
+
+bool clock_configure(enum clock_index clk, uint32_t src, uint32_t auxsrc, uint32_t src_freq, uint32_t freq) {
+    (void)src; (void)auxsrc; (void)src_freq;
+    if (clk == clk_sys) sys_hz = freq;
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk) {
+    return clk == clk_sys ? sys_hz : 48000000;
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    (void)required;
+    sys_hz = freq_khz * 1000;
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// Flash
+//--------------------------------------------------------------------+
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+// Like the SDK: 64 KB block erase where aligned, 4 KB sectors otherwise
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    uint64_t cost = 0;
+    while (count) {
+        size_t n = (flash_offs % FLASH_BLOCK_SIZE == 0 && count >= FLASH_BLOCK_SIZE) ? FLASH_BLOCK_SIZE : FLASH_SECTOR_SIZE;
+        memset(&sim_flash[flash_offs], 0xFF, n);
+        cost += n == FLASH_BLOCK_SIZE ? FLASH_BLOCK_ERASE_US : FLASH_SECTOR_ERASE_US;
+        flash_offs += (uint32_t)n;
+        count -= n < count ? n : count;
+    }
+    sim_wait(sim_now() + cost, false);
+}
+
+void flash_range_program(uint32_t flash_offs, uint8_t const *data, size_t count) {
+    for (size_t i = 0; i < count; i++) sim_flash[flash_offs + i] &= data[i];
+    sim_wait(sim_now() + (count + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_PROGRAM_US, false);
+}
+
+//--------------------------------------------------------------------+
+// USB host
+//--------------------------------------------------------------------+
+
+static uint32_t frame_us = 1000;
+static bool initialised = false;
+static bool mounted = false;
+static bool suspended = false;
+static bool in_flight = false;
+static bool boot_protocol = false;
+static uint8_t last_report[HID_NKRO_REPORT_LEN];
+static uint16_t last_report_len = 0;
+
+// Set from interrupts, handled by tud_task() like TinyUSB's event queue
+static volatile bool mount_pending = false;
+static volatile bool complete_pending = false;
+static volatile bool suspend_pending = false;
+static volatile bool resume_pending = false;
+static volatile bool feature_pending = false;
+static volatile bool led_pending = false;
+static volatile bool coding_pending = false;
+static volatile bool out_pending = false;
+static volatile bool protocol_pending = false;
+static volatile bool cdc_rx_pending = false;
+static bool protocol_boot_request = false;
+static bool out_scheduled = false;
+static cdc_line_coding_t line_coding = { 115200, 0, 0, 8 };
+
+static sim_hid_record_t hid_log[MAX_HID_RECORDS];
+static size_t hid_count = 0;
+static sim_feature_record_t feature_log[MAX_FEATURE_RECORDS];
+static size_t feature_count = 0;
+
+static char cdc_rx[CDC_RX_SIZE];
+static size_t cdc_rx_head = 0;
+static size_t cdc_rx_tail = 0;
+
+void sim_usb_set_frame_us(uint32_t us) {
+    frame_us = us ? us : 1;
+}
+
+static void on_mount(void *arg)    { (void)arg; mount_pending = true; }
+static void on_complete(void *arg) { (void)arg; complete_pending = true; }
+static void on_suspend(void *arg)  { (void)arg; suspend_pending = true; }
+static void on_resume(void *arg)   { (void)arg; resume_pending = true; }
+static void on_feature(void *arg)  { (void)arg; feature_pending = true; }
+static void on_led(void *arg)      { (void)arg; led_pending = true; }
+static void on_out(void *arg)      { (void)arg; out_pending = true; out_scheduled = false; }
+
+static void on_protocol(void *arg) {
+    protocol_boot_request = arg != NULL;
+    protocol_pending = true;
+}
+
+static void on_line_coding(void *arg) {
+    line_coding.bit_rate = (uint32_t)(uintptr_t)arg;
+    coding_pending = true;
+}
+
+static void on_cdc_rx(void *arg) {
+    for (char const *c = arg; *c; c++) {
+        if ((cdc_rx_head + 1) % CDC_RX_SIZE == cdc_rx_tail) break;
+        cdc_rx[cdc_rx_head] = *c;
+        cdc_rx_head = (cdc_rx_head + 1) % CDC_RX_SIZE;
+    }
+    cdc_rx_pending = true;
+}
+
+void sim_usb_suspend(uint64_t at_us) {
+    sim_irq(at_us, 0, on_suspend, NULL);
+}
+
+void sim_usb_resume(uint64_t at_us) {
+    sim_irq(at_us, 0, on_resume, NULL);
+}
+
+void sim_hid_set_protocol(uint64_t at_us, bool boot) {
+    sim_irq(at_us, 0, on_protocol, boot ? (void *)1 : NULL);
+}
+
+void sim_hid_get_feature(uint64_t at_us) {
+    sim_irq(at_us, 0, on_feature, NULL);
+}
+
+size_t sim_feature_count(void) {
+    return feature_count;
+}
+
+sim_feature_record_t const *sim_feature_log(void) {
+    return feature_log;
+}
+
+void sim_cdc_line_coding(uint64_t at_us, uint32_t bit_rate) {
+    sim_irq(at_us, 0, on_line_coding, (void *)(uintptr_t)bit_rate);
+}
+
+void sim_cdc_input(uint64_t at_us, char const *text) {
+    sim_irq(at_us, 0, on_cdc_rx, (void *)text);
+}
+
+size_t sim_hid_count(void) {
+    return hid_count;
+}
+
+sim_hid_record_t const *sim_hid_log(void) {
+    return hid_log;
+}
+
+//--------------------------------------------------------------------+
+// Enumeration - descriptor requests as each host OS makes them
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint8_t type;       // descriptor type, or 0 to end the list
+    uint8_t index;
+    uint16_t langid;
+    uint16_t length;    // wLength
+} enum_request_t;
+
+// Captured from real hosts enumerating the keyboard, trimmed to the
+// GET_DESCRIPTOR requests (SET_ADDRESS, SET_CONFIGURATION etc. omitted)
+static const enum_request_t enum_linux[] = {
+    { TUSB_DESC_DEVICE, 0, 0, 64 },
+    { TUSB_DESC_DEVICE, 0, 0, 18 },
+    { TUSB_DESC_CONFIGURATION, 0, 0, 9 },
+    { TUSB_DESC_CONFIGURATION, 0, 0, 34 },
+    { TUSB_DESC_STRING, 0, 0, 255 },
+    { TUSB_DESC_STRING, 2, 0x0409, 255 },
+    { TUSB_DESC_STRING, 1, 0x0409, 255 },
+    { HID_DESC_TYPE_REPORT, 0, 0, 128 },
+    { 0 },
+};
+
+static const enum_request_t enum_windows[] = {
+    { TUSB_DESC_DEVICE, 0, 0, 64 },
+    { TUSB_DESC_DEVICE, 0, 0, 18 },
+    { TUSB_DESC_CONFIGURATION, 0, 0, 255 },
+    { TUSB_DESC_STRING, 0xEE, 0, 18 },
+    { TUSB_DESC_STRING, 0, 0, 255 },
+    { TUSB_DESC_STRING, 2, 0x0409, 255 },
+    { HID_DESC_TYPE_REPORT, 0, 0, 128 },
+    { 0 },
+};
+
+static const enum_request_t enum_macos[] = {
+    { TUSB_DESC_DEVICE, 0, 0, 8 },
+    { TUSB_DESC_DEVICE, 0, 0, 18 },
+    { TUSB_DESC_CONFIGURATION, 0, 0, 9 },
+    { TUSB_DESC_CONFIGURATION, 0, 0, 34 },
+    { TUSB_DESC_STRING, 0, 0, 2 },
+    { TUSB_DESC_STRING, 0, 0, 4 },
+    { TUSB_DESC_STRING, 2, 0x0409, 2 },
+    { TUSB_DESC_STRING, 2, 0x0409, 40 },
+    { HID_DESC_TYPE_REPORT, 0, 0, 128 },
+    { 0 },
+};
+
+static sim_host_t host = SIM_HOST_NONE;
+
+void sim_usb_set_host(sim_host_t os) {
+    host = os;
+}
+
+// Put the request in the setup packet, as the controller does, and call
+// the firmware's descriptor callback for it
+static void enumerate(void) {
+    enum_request_t const *req;
+    switch (host) {
+        case SIM_HOST_LINUX:   req = enum_linux; break;
+        case SIM_HOST_WINDOWS: req = enum_windows; break;
+        case SIM_HOST_MACOS:   req = enum_macos; break;
+        default:               return;
+    }
+
+    for (; req->type; req++) {
+        uint8_t setup[8] = {
+            req->type == HID_DESC_TYPE_REPORT ? 0x81 : 0x80, 0x06,
+            req->index, req->type,
+            (uint8_t)req->langid, (uint8_t)(req->langid >> 8),
+            (uint8_t)req->length, (uint8_t)(req->length >> 8),
+        };
+        for (int i = 0; i < 8; i++) usb_dpram->setup_packet[i] = setup[i];
+
+        switch (req->type) {
+            case TUSB_DESC_DEVICE:        tud_descriptor_device_cb(); break;
+            case TUSB_DESC_CONFIGURATION: tud_descriptor_configuration_cb(req->index); break;
+            case TUSB_DESC_STRING:        tud_descriptor_string_cb(req->index, req->langid); break;
+            case HID_DESC_TYPE_REPORT:    tud_hid_descriptor_report_cb(0); break;
+        }
+    }
+
+    // Linux and Windows set the keyboard LEDs once their HID driver binds
+    if (host == SIM_HOST_LINUX || host == SIM_HOST_WINDOWS) {
+        sim_irq(sim_now() + USB_LED_US, 0, on_led, NULL);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Upload interface (HID instance 1)
+//--------------------------------------------------------------------+
+
+typedef struct {
+    uint64_t at_us;
+    uint8_t data[64];
+    bool wait_reply;
+} out_report_t;
+
+static out_report_t out_queue[MAX_OUT_REPORTS];
+static size_t out_count = 0;
+static size_t out_next = 0;
+static bool out_waiting = false;  // host holds the queue for a reply
+
+static sim_hid_in_record_t in_log[MAX_IN_RECORDS];
+static size_t in_count = 0;
+
+static void out_schedule(void) {
+    if (out_next >= out_count || out_waiting || out_scheduled) return;
+    uint64_t next_frame = (sim_now() / frame_us + 1) * frame_us;
+    uint64_t at = out_queue[out_next].at_us;
+    out_scheduled = true;
+    sim_irq(at > next_frame ? at : next_frame, 0, on_out, NULL);
+}
+
+void sim_hid_out(uint64_t at_us, uint8_t const report[64], bool wait_reply) {
+    if (out_count >= MAX_OUT_REPORTS) return;
+    out_report_t *r = &out_queue[out_count++];
+    r->at_us = at_us;
+    memcpy(r->data, report, 64);
+    r->wait_reply = wait_reply;
+    out_schedule();
+}
+
+// Called from tud_task(); the endpoint NAKs until the callback returns
+static void out_deliver(void) {
+    if (out_next >= out_count) return;
+    out_report_t const *r = &out_queue[out_next++];
+    out_waiting = r->wait_reply;
+    // TinyUSB passes OUT endpoint data with no report type
+    tud_hid_set_report_cb(1, 0, HID_REPORT_TYPE_INVALID, r->data, 64);
+    out_schedule();
+}
+
+static bool keyboard_in(uint8_t const *report, uint16_t len);
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report, uint16_t len) {
+    (void)report_id;
+    if (instance == 0) return keyboard_in(report, len);
+    if (in_count < MAX_IN_RECORDS) {
+        sim_hid_in_record_t *rec = &in_log[in_count++];
+        rec->time_us = (sim_now() / frame_us + 1) * frame_us;
+        memset(rec->data, 0, sizeof(rec->data));
+        memcpy(rec->data, report, len < sizeof(rec->data) ? len : sizeof(rec->data));
+    }
+    if (out_waiting) {
+        out_waiting = false;
+        out_schedule();
+    }
+    return true;
+}
+
+size_t sim_hid_in_count(void) {
+    return in_count;
+}
+
+sim_hid_in_record_t const *sim_hid_in_log(void) {
+    return in_log;
+}
+
+// Weak defaults, as in TinyUSB
+__attribute__((weak)) void tud_mount_cb(void) {}
+__attribute__((weak)) void tud_umount_cb(void) {}
+__attribute__((weak)) void tud_suspend_cb(bool remote_wakeup_en) { (void)remote_wakeup_en; }
+__attribute__((weak)) void tud_resume_cb(void) {}
+__attribute__((weak)) void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding) {
+    (void)itf; (void)p_line_coding;
+}
+__attribute__((weak)) void tud_cdc_rx_cb(uint8_t itf) {
+    (void)itf;
+}
+__attribute__((weak)) uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen) {
+    (void)instance; (void)report_id; (void)report_type; (void)buffer; (void)reqlen;
+    return 0;
+}
+__attribute__((weak)) void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
+    (void)instance; (void)report; (void)len;
+}
+__attribute__((weak)) void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol) {
+    (void)instance; (void)protocol;
+}
+
+bool tusb_init(void) {
+    if (!initialised) sim_irq(sim_now() + USB_ENUM_US, 0, on_mount, NULL);
+    initialised = true;
+    return true;
+}
+
+void tud_task(void) {
+    if (mount_pending) {
+        mount_pending = false;
+        enumerate();
+        mounted = true;
+        boot_protocol = false;
+        tud_mount_cb();
+    }
+    if (coding_pending && mounted) {
+        coding_pending = false;
+        tud_cdc_line_coding_cb(0, &line_coding);
+    }
+    if (cdc_rx_pending && mounted) {
+        cdc_rx_pending = false;
+        tud_cdc_rx_cb(0);
+    }
+    if (out_pending && mounted && !suspended) {
+        out_pending = false;
+        out_deliver();
+    }
+    if (led_pending && mounted) {
+        led_pending = false;
+        uint8_t leds = 0;
+        tud_hid_set_report_cb(0, 0, HID_REPORT_TYPE_OUTPUT, &leds, 1);
+    }
+    if (protocol_pending && mounted) {
+        protocol_pending = false;
+        boot_protocol = protocol_boot_request;
+        tud_hid_set_protocol_cb(0, boot_protocol ? HID_PROTOCOL_BOOT : HID_PROTOCOL_REPORT);
+    }
+    if (suspend_pending) {
+        suspend_pending = false;
+        suspended = true;
+        tud_suspend_cb(true);
+    }
+    if (resume_pending) {
+        resume_pending = false;
+        suspended = false;
+        tud_resume_cb();
+    }
+    if (feature_pending && mounted && !suspended) {
+        feature_pending = false;
+        if (feature_count < MAX_FEATURE_RECORDS) {
+            sim_feature_record_t *r = &feature_log[feature_count++];
+            r->time_us = sim_now();
+            r->len = tud_hid_get_report_cb(0, 0, HID_REPORT_TYPE_FEATURE, r->data, sizeof(r->data));
+        }
+    }
+    if (complete_pending) {
+        complete_pending = false;
+        in_flight = false;
+        tud_hid_report_complete_cb(0, last_report, last_report_len);
+    }
+    sim_wait(sim_now() + USB_TASK_US, false);
+}
+
+bool tud_mounted(void) {
+    return mounted;
+}
+
+bool tud_suspended(void) {
+    return suspended;
+}
+
+bool tud_remote_wakeup(void) {
+    if (!suspended) return false;
+    sim_irq(sim_now() + USB_RESUME_US, 0, on_resume, NULL);
+    return true;
+}
+
+bool tud_hid_ready(void) {
+    return mounted && !suspended && !in_flight;
+}
+
+// The host takes the report at the next frame boundary it polls, and reads
+// it as the protocol it selected says: the boot layout, or the layout the
+// report descriptor declares (hid_queue.h)
+static bool keyboard_in(uint8_t const *report, uint16_t len) {
+    if (!tud_hid_ready()) return false;
+
+    uint64_t now = sim_now();
+    uint64_t frame = (now / frame_us + 1) * frame_us;
+
+    memset(last_report, 0, sizeof(last_report));
+    last_report_len = len < sizeof(last_report) ? len : sizeof(last_report);
+    memcpy(last_report, report, last_report_len);
+    in_flight = true;
+
+    if (hid_count < MAX_HID_RECORDS) {
+        sim_hid_record_t *rec = &hid_log[hid_count++];
+        memset(rec, 0, sizeof(*rec));
+        rec->time_us = frame;
+        rec->modifier = last_report[0];
+        if (boot_protocol || !HID_NKRO) {
+            memcpy(rec->keycode, &last_report[2], 6);
+        } else {
+            int n = 0;
+            for (int k = 0; k < HID_NKRO_USAGES && n < 6; k++) {
+                if (last_report[1 + k / 8] & (1u << (k % 8))) rec->keycode[n++] = (uint8_t)k;
+            }
+        }
+    }
+    sim_irq(frame, 0, on_complete, NULL);
+    return true;
+}
+
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t const keycode[6]) {
+    (void)report_id;
+    uint8_t report[8] = { modifier, 0 };
+    memcpy(&report[2], keycode, 6);
+    return keyboard_in(report, sizeof(report));
+}
+
+//--------------------------------------------------------------------+
+// CDC - output goes to stdout, tagged with the virtual time the host
+// received it
+//--------------------------------------------------------------------+
+
+// TX FIFO as in TinyUSB: writes that do not fit are cut short, a full
+// packet is queued as soon as one is buffered, a flush queues a short one.
+// The host takes one bulk packet per frame.
+#define CDC_TX_SIZE   256  // CFG_TUD_CDC_TX_BUFSIZE
+#define CDC_PACKET    64
+
+static char cdc_tx[CDC_TX_SIZE];
+static size_t cdc_tx_count = 0;
+static size_t cdc_tx_head = 0;
+static bool cdc_flush_pending = false;
+static bool cdc_packet_in_flight = false;
+static uint64_t cdc_dropped = 0;
+static uint64_t cdc_packets = 0;
+static bool cdc_line_start = true;
+
+static void cdc_schedule(void);
+
+static void on_cdc_packet(void *arg) {
+    (void)arg;
+    size_t n = cdc_tx_count < CDC_PACKET ? cdc_tx_count : CDC_PACKET;
+    for (size_t i = 0; i < n; i++) {
+        char c = cdc_tx[(cdc_tx_head + CDC_TX_SIZE - cdc_tx_count + i) % CDC_TX_SIZE];
+        if (cdc_line_start) printf("cdc %10llu | ", (unsigned long long)sim_now());
+        if ((uint8_t)c < 0x20 && c != '\r' && c != '\n' && c != '\t') printf("\\x%02X", (uint8_t)c);
+        else if (c != '\r') putchar(c);
+        cdc_line_start = (c == '\n');
+    }
+    cdc_tx_count -= n;
+    cdc_packets++;
+    cdc_packet_in_flight = false;
+    if (cdc_tx_count == 0) cdc_flush_pending = false;
+    cdc_schedule();
+}
+
+static void cdc_schedule(void) {
+    if (cdc_packet_in_flight || cdc_tx_count == 0) return;
+    if (cdc_tx_count < CDC_PACKET && !cdc_flush_pending) return;
+
+    uint64_t frame = (sim_now() / frame_us + 1) * frame_us;
+    cdc_packet_in_flight = true;
+    sim_irq(frame, 0, on_cdc_packet, NULL);
+}
+
+bool tud_cdc_connected(void) {
+    return mounted && !suspended;
+}
+
+uint32_t tud_cdc_available(void) {
+    return (uint32_t)((cdc_rx_head + CDC_RX_SIZE - cdc_rx_tail) % CDC_RX_SIZE);
+}
+
+int32_t tud_cdc_read_char(void) {
+    if (cdc_rx_head == cdc_rx_tail) return -1;
+    char c = cdc_rx[cdc_rx_tail];
+    cdc_rx_tail = (cdc_rx_tail + 1) % CDC_RX_SIZE;
+    return (uint8_t)c;
+}
+
+bool tud_cdc_peek(uint8_t *chr) {
+    if (cdc_rx_head == cdc_rx_tail) return false;
+    *chr = (uint8_t)cdc_rx[cdc_rx_tail];
+    return true;
+}
+
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize) {
+    char const *p = buffer;
+    uint32_t n = 0;
+    while (n < bufsize && cdc_tx_count < CDC_TX_SIZE) {
+        cdc_tx[cdc_tx_head] = p[n++];
+        cdc_tx_head = (cdc_tx_head + 1) % CDC_TX_SIZE;
+        cdc_tx_count++;
+    }
+    cdc_dropped += bufsize - n;
+    cdc_schedule();
+    return n;
+}
+
+uint32_t tud_cdc_write_str(char const *str) {
+    return tud_cdc_write(str, (uint32_t)strlen(str));
+}
+
+uint32_t tud_cdc_write_flush(void) {
+    if (cdc_tx_count == 0) return 0;
+    cdc_flush_pending = true;
+    cdc_schedule();
+    return (uint32_t)cdc_tx_count;
+}
+
+uint32_t tud_cdc_write_available(void) {
+    return (uint32_t)(CDC_TX_SIZE - cdc_tx_count);
+}
+
+uint64_t sim_cdc_dropped(void) {
+    return cdc_dropped;
+}
+
+uint64_t sim_cdc_packets(void) {
+    return cdc_packets;
+}
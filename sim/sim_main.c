@@ -0,0 +1,366 @@
+// Simulation runner - loads a scenario, runs the firmware, reports timing
+//
+// Usage: sim_<firmware> <scenario> [--hid-log <file.csv>]
+//
+// Scenario lines (times in virtual microseconds since power-on):
+//   run <us>                                  length of the run
+//   frame <us>                                host HID poll interval (default 1000)
+//   pin <t> <gpio> <0|1>                      drive an input pin from t
+//   bounce <t> <gpio> <level> <edges> <us>    contact chatter settling at level
+//   switch <t> <row gpio> <col gpio> <0|1>    close/open a matrix key
+//   cdc <t> <text>                            bytes arriving on the CDC port (\xNN escapes)
+//   baud <t> <rate>                           host sets the CDC line coding
+//   suspend <t> / resume <t>                  host suspends/resumes the bus
+//   feature <t>                               host reads the perf counters report
+//   protocol <t> <boot|report>                host selects the keyboard's HID protocol
+//   host <none|linux|windows|macos>           enumerate like this OS (default none)
+//   upload <t> <file.bin> [bytes]             push a macro library over the upload
+//                                             interface, as lenny_upload does; stop
+//                                             after bytes without committing. Relative
+//                                             paths are from the simulator's directory
+//   config <t> <name> [value]                 store a setting as lenny_config does, or
+//                                             without a value clear it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "perf.h"
+#include "macro_upload.h"
+#include "config_store.h"
+
+#define SEQUENCE_GAP_US 50000  // reports further apart than this start a new sequence
+#define BURST_GAP_US    20000  // raw edges closer than this belong to one bounce burst
+
+int firmware_main(void);
+
+static void firmware_entry(void) {
+    firmware_main();
+}
+
+static uint64_t run_us = 5000000;
+static char const *exe_dir = ".";
+
+// Copy of s with \xNN replaced by the byte
+static char *unescape(char const *s) {
+    char *out = malloc(strlen(s) + 1), *o = out;
+    unsigned v;
+    while (*s) {
+        if (s[0] == '\\' && s[1] == 'x' && sscanf(s + 2, "%2x", &v) == 1) {
+            *o++ = (char)v;
+            s += 4;
+        } else {
+            *o++ = *s++;
+        }
+    }
+    *o = 0;
+    return out;
+}
+
+static bool parse_host(char const *name, sim_host_t *host) {
+    static char const *const names[] = { "none", "linux", "windows", "macos" };
+    for (int i = 0; i < 4; i++) {
+        if (!strcmp(name, names[i])) { *host = (sim_host_t)i; return true; }
+    }
+    return false;
+}
+
+static uint32_t crc32(uint8_t const *p, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Queue the reports lenny_upload would send for the file
+static int queue_upload(uint64_t at_us, char const *file, long stop_after) {
+    char path[512];
+    if (file[0] == '/') snprintf(path, sizeof(path), "%s", file);
+    else snprintf(path, sizeof(path), "%s/%s", exe_dir, file);
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return -1; }
+    static uint8_t image[MACRO_UPLOAD_SLOT_SIZE];
+    size_t len = fread(image, 1, sizeof(image), f);
+    fclose(f);
+
+    uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { MACRO_UPLOAD_BEGIN };
+    uint32_t crc = crc32(image, len);
+    for (int i = 0; i < 4; i++) {
+        r[1 + i] = (uint8_t)(len >> (8 * i));
+        r[5 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    sim_hid_out(at_us, r, true);
+
+    size_t end = stop_after >= 0 && (size_t)stop_after < len ? (size_t)stop_after : len;
+    for (size_t off = 0; off < end; off += MACRO_UPLOAD_DATA_SIZE) {
+        memset(r, 0, sizeof(r));
+        r[0] = MACRO_UPLOAD_DATA;
+        r[1] = (uint8_t)off;
+        r[2] = (uint8_t)(off >> 8);
+        r[3] = (uint8_t)(off >> 16);
+        memcpy(&r[4], image + off, len - off < MACRO_UPLOAD_DATA_SIZE ? len - off : MACRO_UPLOAD_DATA_SIZE);
+        sim_hid_out(at_us, r, false);
+    }
+
+    if (stop_after < 0) {
+        memset(r, 0, sizeof(r));
+        r[0] = MACRO_UPLOAD_COMMIT;
+        sim_hid_out(at_us, r, true);
+    }
+    return 0;
+}
+
+static bool queue_config(uint64_t at_us, char const *name, bool set, uint32_t value) {
+    static char const *const names[] = CONFIG_KEY_NAMES;
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (strcmp(name, names[key])) continue;
+        uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { MACRO_UPLOAD_CONFIG_SET, (uint8_t)key, set };
+        for (int i = 0; i < 4; i++) r[3 + i] = (uint8_t)(value >> (8 * i));
+        sim_hid_out(at_us, r, true);
+        return true;
+    }
+    return false;
+}
+
+static int load_scenario(char const *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+
+    char line[512];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = 0;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == 0) continue;
+
+        char cmd[16], name[16], file[256];
+        sim_host_t host;
+        unsigned long long t;
+        unsigned a, b, c, d;
+        long bytes;
+        int used, n;
+        if (sscanf(p, "%15s%n", cmd, &used) != 1) continue;
+        char const *args = p + used;
+
+        if (!strcmp(cmd, "run") && sscanf(args, "%llu", &t) == 1) {
+            run_us = t;
+        } else if (!strcmp(cmd, "frame") && sscanf(args, "%u", &a) == 1) {
+            sim_usb_set_frame_us(a);
+        } else if (!strcmp(cmd, "pin") && sscanf(args, "%llu %u %u", &t, &a, &b) == 3) {
+            sim_gpio_wave((uint8_t)a, t, b != 0);
+        } else if (!strcmp(cmd, "bounce") && sscanf(args, "%llu %u %u %u %u", &t, &a, &b, &c, &d) == 5) {
+            for (unsigned i = 0; i < c; i++) {
+                sim_gpio_wave((uint8_t)a, t + (uint64_t)i * d, (i % 2 == 0) == (b != 0));
+            }
+            if (c % 2 == 0) sim_gpio_wave((uint8_t)a, t + (uint64_t)c * d, b != 0);
+        } else if (!strcmp(cmd, "switch") && sscanf(args, "%llu %u %u %u", &t, &a, &b, &c) == 4) {
+            sim_gpio_switch((uint8_t)a, (uint8_t)b, t, c != 0);
+        } else if (!strcmp(cmd, "cdc") && sscanf(args, "%llu %n", &t, &used) == 1) {
+            sim_cdc_input(t, unescape(args + used));
+        } else if (!strcmp(cmd, "baud") && sscanf(args, "%llu %u", &t, &a) == 2) {
+            sim_cdc_line_coding(t, a);
+        } else if (!strcmp(cmd, "suspend") && sscanf(args, "%llu", &t) == 1) {
+            sim_usb_suspend(t);
+        } else if (!strcmp(cmd, "resume") && sscanf(args, "%llu", &t) == 1) {
+            sim_usb_resume(t);
+        } else if (!strcmp(cmd, "feature") && sscanf(args, "%llu", &t) == 1) {
+            sim_hid_get_feature(t);
+        } else if (!strcmp(cmd, "protocol") && sscanf(args, "%llu %15s", &t, name) == 2 &&
+                   (!strcmp(name, "boot") || !strcmp(name, "report"))) {
+            sim_hid_set_protocol(t, !strcmp(name, "boot"));
+        } else if (!strcmp(cmd, "host") && sscanf(args, "%15s", name) == 1 && parse_host(name, &host)) {
+            sim_usb_set_host(host);
+        } else if (!strcmp(cmd, "upload") && (n = sscanf(args, "%llu %255s %ld", &t, file, &bytes)) >= 2) {
+            if (queue_upload(t, file, n == 3 ? bytes : -1) < 0) {
+                fclose(f);
+                return -1;
+            }
+        } else if (!strcmp(cmd, "config") && (n = sscanf(args, "%llu %15s %u", &t, name, &a)) >= 2) {
+            if (!queue_config(t, name, n == 3, a)) {
+                fprintf(stderr, "%s:%d: unknown setting '%s'\n", path, lineno, name);
+                fclose(f);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, lineno, p);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+//--------------------------------------------------------------------+
+// Report
+//--------------------------------------------------------------------+
+
+// Start of the bounce burst that the filter confirmed at confirm_us: the
+// first raw edge after the previous confirmation not followed by a quiet gap
+static uint64_t burst_start(uint8_t pin, uint64_t after_us, uint64_t confirm_us) {
+    uint64_t start = SIM_FOREVER;
+    uint64_t last = 0;
+    for (uint64_t t = sim_gpio_wave_next(pin, after_us); t <= confirm_us; t = sim_gpio_wave_next(pin, t)) {
+        if (start == SIM_FOREVER || t - last > BURST_GAP_US) start = t;
+        last = t;
+    }
+    return start == SIM_FOREVER ? confirm_us : start;
+}
+
+static void report_debounce(void) {
+    sim_filter_record_t const *f = sim_filter_log();
+    size_t n = sim_filter_count();
+    uint64_t prev[32] = {0};
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t edge = burst_start(f[i].pin, prev[f[i].pin], f[i].time_us);
+        printf("debounce gpio=%u %s at_us=%llu edge_to_confirm_us=%llu\n",
+               f[i].pin, f[i].pressed ? "pressed" : "released",
+               (unsigned long long)f[i].time_us,
+               (unsigned long long)(f[i].time_us - edge));
+
+        // Trigger latency: raw edge to the first report the host saw before
+        // the next press (none if the text went to the companion daemon)
+        if (f[i].pressed) {
+            uint64_t next = SIM_FOREVER;
+            for (size_t j = i + 1; j < n && next == SIM_FOREVER; j++) {
+                if (f[j].pressed) next = f[j].time_us;
+            }
+            sim_hid_record_t const *h = sim_hid_log();
+            for (size_t r = 0; r < sim_hid_count(); r++) {
+                if (h[r].time_us < f[i].time_us) continue;
+                if (h[r].time_us >= next) break;
+                printf("trigger gpio=%u edge_to_first_report_us=%llu confirm_to_first_report_us=%llu\n",
+                       f[i].pin, (unsigned long long)(h[r].time_us - edge),
+                       (unsigned long long)(h[r].time_us - f[i].time_us));
+                break;
+            }
+        }
+        prev[f[i].pin] = f[i].time_us;
+    }
+}
+
+static void report_sequences(void) {
+    sim_hid_record_t const *h = sim_hid_log();
+    size_t n = sim_hid_count();
+    printf("hid_reports=%zu\n", n);
+
+    size_t start = 0;
+    int seq = 0;
+    for (size_t i = 1; i <= n; i++) {
+        if (i < n && h[i].time_us - h[i - 1].time_us <= SEQUENCE_GAP_US) continue;
+
+        size_t count = i - start;
+        uint64_t duration = h[i - 1].time_us - h[start].time_us;
+        printf("sequence %d start_us=%llu reports=%zu duration_us=%llu us_per_report=%llu\n",
+               ++seq, (unsigned long long)h[start].time_us, count,
+               (unsigned long long)duration,
+               (unsigned long long)(count > 1 ? duration / (count - 1) : 0));
+        start = i;
+    }
+}
+
+static void report_features(void) {
+    sim_feature_record_t const *f = sim_feature_log();
+    for (size_t i = 0; i < sim_feature_count(); i++) {
+        perf_report_t r;
+        if (f[i].len < sizeof(r)) {
+            printf("feature at_us=%llu len=%u\n", (unsigned long long)f[i].time_us, f[i].len);
+            continue;
+        }
+        memcpy(&r, f[i].data, sizeof(r));
+        printf("feature at_us=%llu len=%u version=%u uptime_ms=%u loop_hist=",
+               (unsigned long long)f[i].time_us, f[i].len, r.version, r.uptime_ms);
+        for (int b = 0; b < PERF_LOOP_BUCKETS; b++) printf("%s%u", b ? "/" : "", r.loop_hist[b]);
+        printf(" loop_max_us=%u task_calls=%u task_total_us=%u task_max_us=%u"
+               " sent=%u retried=%u dropped=%u edges=%u rejects=%u"
+               " sequences=%u sequence_last_us=%u sequence_max_us=%u task_interval_max_us=%u"
+               " burst_faces=%u burst_us=%u burst_last_faces=%u burst_last_us=%u discarded=%u\n",
+               r.loop_max_us, r.task_calls, r.task_total_us, r.task_max_us,
+               r.reports_sent, r.reports_retried, r.reports_dropped,
+               r.debounce_edges, r.debounce_rejects,
+               r.sequences, r.sequence_last_us, r.sequence_max_us, r.task_interval_max_us,
+               r.burst_faces, r.burst_us, r.burst_last_faces, r.burst_last_us, r.reports_discarded);
+    }
+}
+
+// Replies on the upload interface, and the data rate of each finished upload
+static void report_uploads(void) {
+    sim_hid_in_record_t const *in = sim_hid_in_log();
+    uint64_t begin_us = 0;
+    for (size_t i = 0; i < sim_hid_in_count(); i++) {
+        uint8_t const *d = in[i].data;
+        if (d[0] == MACRO_UPLOAD_CONFIG_SET || d[0] == MACRO_UPLOAD_CONFIG_GET) {
+            static char const *const names[] = CONFIG_KEY_NAMES;
+            printf("config at_us=%llu status=%u %s=", (unsigned long long)in[i].time_us, d[1],
+                   d[2] < CONFIG_KEY_COUNT ? names[d[2]] : "?");
+            if (d[3]) printf("%u\n", d[4] | d[5] << 8 | d[6] << 16 | (uint32_t)d[7] << 24);
+            else printf("default\n");
+            continue;
+        }
+        uint32_t received = d[2] | (uint32_t)d[3] << 8 | (uint32_t)d[4] << 16 | (uint32_t)d[5] << 24;
+        uint32_t generation = d[6] | (uint32_t)d[7] << 8 | (uint32_t)d[8] << 16 | (uint32_t)d[9] << 24;
+        printf("upload at_us=%llu cmd=%c status=%u received=%u generation=%u macros=%u slot=%d",
+               (unsigned long long)in[i].time_us, d[0], d[1], received, generation,
+               d[10] | d[11] << 8, (int8_t)d[12]);
+        if (d[0] == MACRO_UPLOAD_BEGIN) begin_us = in[i].time_us;
+        if (d[0] == MACRO_UPLOAD_COMMIT && d[1] == UPLOAD_OK && in[i].time_us > begin_us) {
+            uint64_t us = in[i].time_us - begin_us;
+            printf(" duration_us=%llu bytes_per_s=%llu", (unsigned long long)us,
+                   (unsigned long long)received * 1000000 / us);
+        }
+        printf("\n");
+    }
+}
+
+static int write_hid_log(char const *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) { perror(path); return -1; }
+
+    sim_hid_record_t const *h = sim_hid_log();
+    fprintf(f, "time_us,modifier,keycode\n");
+    for (size_t i = 0; i < sim_hid_count(); i++) {
+        // Keys pressed together go in one field, space-separated
+        fprintf(f, "%llu,0x%02X,0x%02X", (unsigned long long)h[i].time_us, h[i].modifier, h[i].keycode[0]);
+        for (int k = 1; k < 6 && h[i].keycode[k]; k++) fprintf(f, " 0x%02X", h[i].keycode[k]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    char const *hid_log_path = NULL;
+    if (argc == 4 && !strcmp(argv[2], "--hid-log")) {
+        hid_log_path = argv[3];
+    } else if (argc != 2) {
+        fprintf(stderr, "usage: %s <scenario> [--hid-log <file.csv>]\n", argv[0]);
+        return 1;
+    }
+
+    char *slash = strrchr(argv[0], '/');
+    if (slash) {
+        *slash = 0;
+        exe_dir = argv[0];
+    }
+    if (load_scenario(argv[1]) < 0) return 1;
+
+    sim_boot(firmware_entry);
+    sim_run(run_us);
+
+    printf("run_us=%llu\n", (unsigned long long)run_us);
+    report_sequences();
+    report_debounce();
+    report_features();
+    report_uploads();
+    if (sim_cdc_packets() > 0) {
+        printf("cdc_packets=%llu cdc_dropped_bytes=%llu\n",
+               (unsigned long long)sim_cdc_packets(), (unsigned long long)sim_cdc_dropped());
+    }
+
+    if (hid_log_path && write_hid_log(hid_log_path) < 0) return 1;
+    return 0;
+}
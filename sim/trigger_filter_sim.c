@@ -0,0 +1,83 @@
+// Simulated PIO trigger filter - same contract as trigger_filter.c
+//
+// The scripted waveform is known up front, so each pin's filter is run over
+// it once when the pin is added: the pin is sampled on the state machine's
+// grid and a level is accepted after the same number of consecutive
+// samples as trigger_filter.pio. Accepted levels are delivered as PIO
+// interrupts on the core that added the pin.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "trigger_filter.h"
+
+#define SAMPLE_US   (1000000 / TRIGGER_FILTER_SAMPLE_HZ)
+#define MAX_RECORDS 4096
+
+typedef struct {
+    uint8_t pin;
+    bool pressed;
+} edge_t;
+
+static trigger_filter_callback_t callback = NULL;
+static edge_t edges[MAX_RECORDS];
+static size_t edge_count = 0;
+
+static sim_filter_record_t log_records[MAX_RECORDS];
+static size_t log_count = 0;
+
+static void on_pio_irq(void *arg) {
+    edge_t const *e = arg;
+    if (log_count < MAX_RECORDS) {
+        log_records[log_count++] = (sim_filter_record_t){ sim_now(), e->pin, e->pressed };
+    }
+    if (callback) callback(e->pin, e->pressed);
+}
+
+void trigger_filter_set_callback(trigger_filter_callback_t cb) {
+    callback = cb;
+}
+
+bool trigger_filter_add_pin(uint8_t pin, uint32_t stable_us) {
+    uint32_t samples = (uint32_t)(((uint64_t)stable_us * TRIGGER_FILTER_SAMPLE_HZ) / 1000000);
+    if (samples < 1) samples = 1;
+
+    uint64_t t = sim_now();
+    bool level = sim_gpio_wave_level(pin, t);
+    uint32_t run = 0;
+
+    // Sample until the waveform has been quiet for longer than the window
+    while (true) {
+        uint64_t next_edge = sim_gpio_wave_next(pin, t);
+        if (next_edge == SIM_FOREVER && run == 0) break;
+
+        t += SAMPLE_US;
+        bool sample = sim_gpio_wave_level(pin, t);
+        run = (sample != level) ? run + 1 : 0;
+        if (run < samples) continue;
+
+        level = sample;
+        run = 0;
+        if (edge_count == MAX_RECORDS) {
+            fprintf(stderr, "sim: too many filtered edges\n");
+            exit(1);
+        }
+        edge_t *e = &edges[edge_count++];
+        e->pin = pin;
+        e->pressed = !level;
+        sim_irq(t, sim_current_core(), on_pio_irq, e);
+    }
+    return true;
+}
+
+void trigger_filter_clock_changed(void) {
+    // The model samples on virtual time, which clock scaling does not touch
+}
+
+size_t sim_filter_count(void) {
+    return log_count;
+}
+
+sim_filter_record_t const *sim_filter_log(void) {
+    return log_records;
+}
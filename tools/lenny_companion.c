@@ -0,0 +1,209 @@
+// lenny_companion - inserts macro text sent by the device over CDC
+//
+// Usage: lenny_companion [-v] [--print | --exec <cmd>] <tty>
+// Opens the device's CDC port at COMPANION_BAUD, which tells the firmware
+// a daemon is listening, answers its handshakes and inserts each text frame
+// in one operation (see companion.h for the protocol). Inserting:
+//   default       text to the clipboard (wl-copy, or xclip under X11), then
+//                 Ctrl+V from a uinput virtual keyboard
+//   --exec <cmd>  run cmd through the shell with the text on stdin
+//   --print       write the text to stdout, one line per frame
+// -v copies everything else on the port (the debug log) to stderr.
+//
+// Any tty works, so a pty pair stands in for the device in tests:
+//   socat -d -d pty,raw,echo=0 pty,raw,echo=0
+// Linux only.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#include "companion.h"
+
+#define MAX_TEXT 4096
+
+static bool verbose = false;
+static bool print_only = false;
+static char const *exec_cmd = NULL;
+static int uinput_fd = -1;
+
+//--------------------------------------------------------------------+
+// Inserting
+//--------------------------------------------------------------------+
+
+static void emit(int type, int code, int value) {
+    struct input_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type = (unsigned short)type;
+    ev.code = (unsigned short)code;
+    ev.value = value;
+    if (write(uinput_fd, &ev, sizeof(ev)) < 0) perror("uinput");
+}
+
+static int uinput_open(void) {
+    int fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("/dev/uinput");
+        return -1;
+    }
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(fd, UI_SET_KEYBIT, KEY_LEFTCTRL);
+    ioctl(fd, UI_SET_KEYBIT, KEY_V);
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "lenny_companion paste");
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        perror("uinput setup");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void run_with_stdin(char const *cmd, char const *text, size_t len) {
+    FILE *p = popen(cmd, "w");
+    if (!p) {
+        perror(cmd);
+        return;
+    }
+    fwrite(text, 1, len, p);
+    int status = pclose(p);
+    if (status != 0) fprintf(stderr, "'%s' exited with %d\n", cmd, status);
+}
+
+static void insert_text(char const *text, size_t len) {
+    if (print_only) {
+        printf("%.*s\n", (int)len, text);
+        fflush(stdout);
+        return;
+    }
+    if (exec_cmd) {
+        run_with_stdin(exec_cmd, text, len);
+        return;
+    }
+
+    run_with_stdin(getenv("WAYLAND_DISPLAY") ? "wl-copy" : "xclip -selection clipboard", text, len);
+    emit(EV_KEY, KEY_LEFTCTRL, 1);
+    emit(EV_KEY, KEY_V, 1);
+    emit(EV_SYN, SYN_REPORT, 0);
+    emit(EV_KEY, KEY_V, 0);
+    emit(EV_KEY, KEY_LEFTCTRL, 0);
+    emit(EV_SYN, SYN_REPORT, 0);
+}
+
+//--------------------------------------------------------------------+
+// Port
+//--------------------------------------------------------------------+
+
+static int port_open(char const *path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) return -1;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) < 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B1000000);  // COMPANION_BAUD
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Frame parser - one byte at a time, anything outside a frame is log text
+typedef struct {
+    uint8_t header[5];  // STX, type, seq, length
+    size_t have;
+    size_t len;
+    char text[MAX_TEXT + 1];
+} parser_t;
+
+static void frame_done(int fd, parser_t *p) {
+    uint8_t type = p->header[1], seq = p->header[2];
+    if (type == COMPANION_PING) {
+        uint8_t ack[2] = { COMPANION_ACK, (uint8_t)(seq | 0x80) };
+        if (write(fd, ack, sizeof(ack)) < 0) perror("write");
+    } else if (type == COMPANION_TEXT && p->len <= MAX_TEXT) {
+        p->text[p->len] = 0;
+        if (verbose) fprintf(stderr, "[companion] text %u: %s\n", seq, p->text);
+        insert_text(p->text, p->len);
+    }
+    p->have = 0;
+}
+
+static void parse(int fd, parser_t *p, uint8_t c) {
+    if (p->have == 0) {
+        if (c == COMPANION_STX) p->header[p->have++] = c;
+        else if (verbose) fputc(c, stderr);
+        return;
+    }
+
+    if (p->have < sizeof(p->header)) {
+        p->header[p->have++] = c;
+        if (p->have == sizeof(p->header)) {
+            p->len = p->header[3] | (size_t)p->header[4] << 8;
+            if (p->len == 0) frame_done(fd, p);
+        }
+        return;
+    }
+
+    size_t at = p->have++ - sizeof(p->header);
+    if (at < MAX_TEXT) p->text[at] = (char)c;
+    if (at + 1 == p->len) frame_done(fd, p);
+}
+
+int main(int argc, char **argv) {
+    char const *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v")) verbose = true;
+        else if (!strcmp(argv[i], "--print")) print_only = true;
+        else if (!strcmp(argv[i], "--exec") && i + 1 < argc) exec_cmd = argv[++i];
+        else if (!path && argv[i][0] != '-') path = argv[i];
+        else { path = NULL; break; }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [-v] [--print | --exec <cmd>] <tty>\n", argv[0]);
+        return 1;
+    }
+    if (!print_only && !exec_cmd && (uinput_fd = uinput_open()) < 0) return 1;
+
+    // The device comes and goes; keep reopening the port
+    static parser_t parser;
+    bool waiting = false;
+    while (true) {
+        int fd = port_open(path);
+        if (fd < 0) {
+            if (!waiting) fprintf(stderr, "waiting for %s: %s\n", path, strerror(errno));
+            waiting = true;
+            sleep(1);
+            continue;
+        }
+        fprintf(stderr, "listening on %s\n", path);
+        waiting = false;
+        parser.have = 0;
+
+        uint8_t buf[256];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0 || (n < 0 && errno == EINTR)) {
+            for (ssize_t i = 0; i < n; i++) parse(fd, &parser, buf[i]);
+        }
+        fprintf(stderr, "%s closed\n", path);
+        close(fd);
+        sleep(1);
+    }
+}
@@ -0,0 +1,116 @@
+// lenny_companion_test - runs the companion daemon against a pty pair
+//
+// Usage: lenny_companion_test <path to lenny_companion>
+// The pty master plays the device: it waits for the daemon to open the port
+// at COMPANION_BAUD, sends a ping frame between log lines and expects the
+// ACK with the same sequence number, then sends a text frame split over two
+// writes and expects the text on the daemon's stdout (--print). Exits 0 if
+// all of that happened. Linux only.
+
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include "companion.h"
+
+#define TIMEOUT_MS 2000
+#define TEXT "( \xCD\xA1\xC2\xB0 \xCD\x9C\xCA\x96 \xCD\xA1\xC2\xB0 )"
+
+static pid_t daemon_pid = -1;
+
+static int fail(char const *what) {
+    fprintf(stderr, "lenny_companion_test: %s\n", what);
+    if (daemon_pid > 0) kill(daemon_pid, SIGTERM);
+    return 1;
+}
+
+// Read exactly len bytes from fd, or give up after TIMEOUT_MS without any
+static bool read_all(int fd, void *buf, size_t len) {
+    uint8_t *p = buf;
+    while (len) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, TIMEOUT_MS) <= 0) return false;
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool write_all(int fd, void const *buf, size_t len) {
+    return write(fd, buf, len) == (ssize_t)len;
+}
+
+// The daemon has the port open once the line is set to COMPANION_BAUD
+static bool wait_for_baud(int master) {
+    for (int waited = 0; waited < TIMEOUT_MS; waited += 10) {
+        struct termios tio;
+        if (tcgetattr(master, &tio) == 0 && cfgetospeed(&tio) == B1000000) return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <lenny_companion>\n", argv[0]);
+        return 1;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return fail("no pty");
+    char const *slave = ptsname(master);
+
+    int out[2];
+    if (pipe(out) < 0) return fail("no pipe");
+
+    daemon_pid = fork();
+    if (daemon_pid < 0) return fail("fork failed");
+    if (daemon_pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(master);
+        execl(argv[1], argv[1], "--print", slave, (char *)NULL);
+        perror(argv[1]);
+        _exit(127);
+    }
+    close(out[1]);
+
+    if (!wait_for_baud(master)) return fail("the daemon never set the port to COMPANION_BAUD");
+
+    // Handshake in the middle of log output
+    uint8_t const ping[] = { COMPANION_STX, COMPANION_PING, 5, 0, 0 };
+    if (!write_all(master, "log line\r\n", 10) || !write_all(master, ping, sizeof(ping))) {
+        return fail("write to the pty failed");
+    }
+    uint8_t ack[2];
+    if (!read_all(master, ack, sizeof(ack))) return fail("no answer to the ping");
+    if (ack[0] != COMPANION_ACK || ack[1] != (5 | 0x80)) return fail("wrong answer to the ping");
+
+    // Text frame, cut in the middle of a character, then more log
+    uint8_t frame[5 + sizeof(TEXT) - 1] = { COMPANION_STX, COMPANION_TEXT, 5, sizeof(TEXT) - 1, 0 };
+    memcpy(&frame[5], TEXT, sizeof(TEXT) - 1);
+    if (!write_all(master, frame, 8)) return fail("write to the pty failed");
+    usleep(20000);
+    if (!write_all(master, &frame[8], sizeof(frame) - 8) || !write_all(master, "more log\n", 9)) {
+        return fail("write to the pty failed");
+    }
+    char line[sizeof(TEXT) + 1];
+    if (!read_all(out[0], line, sizeof(line) - 1)) return fail("the daemon printed no text");
+    line[sizeof(line) - 1] = 0;
+    if (strcmp(line, TEXT "\n") != 0) return fail("the daemon printed something else");
+
+    kill(daemon_pid, SIGTERM);
+    waitpid(daemon_pid, NULL, 0);
+    printf("lenny_companion_test: ok\n");
+    return 0;
+}
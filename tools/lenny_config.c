@@ -0,0 +1,122 @@
+// lenny_config - reads and writes the settings stored on a running device
+//
+// Usage: lenny_config </dev/hidrawN> [name | name=value | name= ...]
+// Without names, prints every setting. name=value stores a value, name=
+// goes back to the firmware's built-in default. Settings live in the
+// device's config store (config_store.h) and survive a reset; see there for
+// the names; layout also takes a keymap.h name (layout=de). Talks to the
+// upload interface, like lenny_upload. Linux only.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "config_store.h"
+#include "keymap.h"
+#include "macro_upload.h"
+
+#define REPLY_TIMEOUT_MS  2000
+
+static char const *const key_names[] = CONFIG_KEY_NAMES;
+static char const *const layout_names[] = KEYMAP_NAMES;
+
+static int find_key(char const *name, size_t len) {
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (strlen(key_names[key]) == len && !strncmp(key_names[key], name, len)) return key;
+    }
+    return -1;
+}
+
+// Send one config command and print the setting from the reply
+static int command(int fd, uint8_t cmd, int key, bool set, uint32_t value) {
+    // Byte 0 is the report ID - 0, the interface uses none
+    uint8_t buf[1 + MACRO_UPLOAD_REPORT_SIZE] = { 0, cmd, (uint8_t)key, set };
+    for (int i = 0; i < 4; i++) buf[4 + i] = (uint8_t)(value >> (8 * i));
+    if (write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        perror("write");
+        return -1;
+    }
+
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    uint8_t d[MACRO_UPLOAD_REPORT_SIZE];
+    do {
+        if (poll(&p, 1, REPLY_TIMEOUT_MS) <= 0) {
+            fprintf(stderr, "no reply from the device\n");
+            return -1;
+        }
+        if (read(fd, d, sizeof(d)) < 8) {
+            perror("read");
+            return -1;
+        }
+    } while (d[0] != cmd);
+
+    if (d[1] == UPLOAD_BUSY) {
+        fprintf(stderr, "%s: device is typing, try again\n", key_names[key]);
+        return -1;
+    }
+    if (d[1] != UPLOAD_OK) {
+        fprintf(stderr, "%s: refused (status %u)\n", key_names[key], d[1]);
+        return -1;
+    }
+    uint32_t v = d[4] | (uint32_t)d[5] << 8 | (uint32_t)d[6] << 16 | (uint32_t)d[7] << 24;
+    if (d[3] && key == CONFIG_LAYOUT && v < KEYMAP_COUNT) printf("%s=%s\n", key_names[key], layout_names[v]);
+    else if (d[3]) printf("%s=%u\n", key_names[key], v);
+    else printf("%s= (default)\n", key_names[key]);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s </dev/hidrawN> [name | name=value | name= ...]\n", argv[0]);
+        return 1;
+    }
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+            if (command(fd, MACRO_UPLOAD_CONFIG_GET, key, false, 0) < 0) return 1;
+        }
+        return 0;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        char const *eq = strchr(argv[i], '=');
+        int key = find_key(argv[i], eq ? (size_t)(eq - argv[i]) : strlen(argv[i]));
+        if (key < 0) {
+            fprintf(stderr, "unknown setting '%s'\n", argv[i]);
+            return 1;
+        }
+
+        int r;
+        if (!eq) {
+            r = command(fd, MACRO_UPLOAD_CONFIG_GET, key, false, 0);
+        } else if (eq[1] == 0) {
+            r = command(fd, MACRO_UPLOAD_CONFIG_SET, key, false, 0);
+        } else {
+            char *end;
+            unsigned long v = strtoul(eq + 1, &end, 0);
+            if (key == CONFIG_LAYOUT) {
+                for (int l = 0; l < KEYMAP_COUNT; l++) {
+                    if (!strcmp(eq + 1, layout_names[l])) {
+                        v = l;
+                        end = "";
+                    }
+                }
+            }
+            if (*end) {
+                fprintf(stderr, "bad value '%s'\n", eq + 1);
+                return 1;
+            }
+            r = command(fd, MACRO_UPLOAD_CONFIG_SET, key, true, (uint32_t)v);
+        }
+        if (r < 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,497 @@
+// lenny_gen - compiles UTF-8 macro strings into a flash macro library
+//
+// Usage: lenny_gen [-l <layout>[,<layout>...]] <macros.txt> <output-basename>
+// Writes <output-basename>.c with the library image (see macro_library.h):
+// one report table per macro, host keyboard layout and input method,
+// already run through key_stream, behind an id-indexed header. Every table
+// is checked against a model of the host: it must type the macro's text,
+// or lenny_gen fails. Layouts are
+// keymap.h names (us, de, fr), up to MACRO_LIB_MAX_LAYOUTS; the first is
+// the default on the device (default: us). <output-basename>.h gets an
+// MACRO_ID_<NAME> per macro. <output-basename>.bin is the same image on its
+// own, for uploading to a running device (lenny_upload).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stddef.h>
+#include "key_stream.h"
+#include "keymap.h"
+#include "macro_library.h"
+
+#define MOD_LCTRL  0x01
+#define MOD_LSHIFT 0x02
+#define MOD_LALT   0x04
+
+#define MAX_REPORTS 4096       // per table
+#define MAX_MACROS  1024
+#define MAX_IMAGE   (1024 * 1024)
+
+typedef struct {
+    hid_report_t reports[MAX_REPORTS];
+    size_t count;
+    hid_report_t taps[MAX_REPORTS];  // as planned, before key_stream
+    size_t tap_count;
+    key_stream_t stream;
+    keymap_layout_t layout;
+    macro_method_t method;
+} plan_t;
+
+static keymap_layout_t layouts[MACRO_LIB_MAX_LAYOUTS] = { KEYMAP_US };
+static uint8_t layout_count = 1;
+
+//--------------------------------------------------------------------+
+// Planning
+//--------------------------------------------------------------------+
+
+static void plan_tap(plan_t *p, uint8_t modifier, uint8_t keycode) {
+    p->taps[p->tap_count++] = (hid_report_t){ modifier, keycode };
+
+    hid_report_t out[2];
+    uint8_t n = key_stream_tap(&p->stream, modifier, keycode, out);
+    for (uint8_t i = 0; i < n; i++) {
+        if (p->count >= MAX_REPORTS - 1) {  // keep room for the final release
+            fprintf(stderr, "lenny_gen: macro longer than %d reports\n", MAX_REPORTS);
+            exit(1);
+        }
+        p->reports[p->count++] = out[i];
+    }
+}
+
+static void plan_end(plan_t *p) {
+    hid_report_t out[1];
+    if (key_stream_end(&p->stream, out)) p->reports[p->count++] = out[0];
+}
+
+// Type an ASCII character on the plan's layout, then Space if it sits on a
+// dead key. Returns false for characters without a key.
+static bool plan_ascii(plan_t *p, char c, uint8_t extra_modifier) {
+    hid_report_t key;
+    bool dead;
+    if (!keymap_lookup(p->layout, p->method, c, &key, &dead)) return false;
+    plan_tap(p, key.modifier | extra_modifier, key.keycode);
+    if (dead) plan_ascii(p, ' ', 0);
+    return true;
+}
+
+static void plan_hex(plan_t *p, uint32_t codepoint) {
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%04x", (unsigned)codepoint);
+    for (char *c = hex; *c; c++) plan_ascii(p, *c, 0);
+}
+
+// Returns false for ASCII control characters that have no key
+static bool plan_codepoint(plan_t *p, uint32_t codepoint) {
+    if (codepoint < 0x80) return plan_ascii(p, (char)codepoint, 0);
+
+    if (p->method == MACRO_METHOD_LINUX) {
+        plan_ascii(p, 'u', MOD_LCTRL | MOD_LSHIFT);
+        plan_hex(p, codepoint);
+        plan_ascii(p, ' ', 0);
+    } else {
+        // Alt+X takes every hex digit before the caret; U+ keeps it from
+        // reaching into hex letters or digits typed just before
+        plan_ascii(p, 'U', 0);
+        plan_ascii(p, '+', 0);
+        plan_hex(p, codepoint);
+        plan_ascii(p, 'x', MOD_LALT);
+    }
+    return true;
+}
+
+// Decode one UTF-8 sequence. Returns bytes consumed, 0 on malformed input.
+static int utf8_decode(const unsigned char *s, uint32_t *codepoint) {
+    if (s[0] < 0x80) { *codepoint = s[0]; return 1; }
+
+    int len;
+    uint32_t cp;
+    if ((s[0] & 0xE0) == 0xC0)      { len = 2; cp = s[0] & 0x1F; }
+    else if ((s[0] & 0xF0) == 0xE0) { len = 3; cp = s[0] & 0x0F; }
+    else if ((s[0] & 0xF8) == 0xF0) { len = 4; cp = s[0] & 0x07; }
+    else return 0;
+
+    for (int i = 1; i < len; i++) {
+        if ((s[i] & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    *codepoint = cp;
+    return len;
+}
+
+//--------------------------------------------------------------------+
+// Host model
+//--------------------------------------------------------------------+
+
+// What the host makes of a report stream: each key going down, with the
+// modifiers of its report (a host applies those first), decoded through
+// the layout and input method into UTF-8 text
+typedef struct {
+    keymap_layout_t layout;
+    macro_method_t method;
+    hid_report_t last;
+    char text[MAX_REPORTS * 4 + 1];
+    size_t len;
+    char dead;        // dead key waiting for its Space
+    bool entry;       // Ctrl+Shift+U, hex digits until Space
+    uint32_t hex;
+    bool bad;         // a key the host would not have turned into text
+} host_t;
+
+static void host_utf8(host_t *h, uint32_t cp) {
+    if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) { h->bad = true; return; }
+    char *t = &h->text[h->len];
+    if (cp < 0x80)         { t[0] = (char)cp; h->len += 1; }
+    else if (cp < 0x800)   { t[0] = (char)(0xC0 | cp >> 6); t[1] = (char)(0x80 | (cp & 0x3F)); h->len += 2; }
+    else if (cp < 0x10000) { t[0] = (char)(0xE0 | cp >> 12); t[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+                             t[2] = (char)(0x80 | (cp & 0x3F)); h->len += 3; }
+    else                   { t[0] = (char)(0xF0 | cp >> 18); t[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+                             t[2] = (char)(0x80 | (cp >> 6 & 0x3F)); t[3] = (char)(0x80 | (cp & 0x3F)); h->len += 4; }
+    h->text[h->len] = 0;
+}
+
+// Alt+X: the hex digits just before the caret become that character, all
+// of them, along with a U+ in front
+static void host_alt_x(host_t *h) {
+    size_t start = h->len;
+    while (start > 0 && isxdigit((unsigned char)h->text[start - 1])) start--;
+    if (start == h->len || h->len - start > 6) { h->bad = true; return; }
+    uint32_t cp = (uint32_t)strtoul(&h->text[start], NULL, 16);
+    if (start >= 2 && toupper((unsigned char)h->text[start - 2]) == 'U' && h->text[start - 1] == '+') start -= 2;
+    h->len = start;
+    host_utf8(h, cp);
+}
+
+static void host_key(host_t *h, uint8_t modifier, uint8_t keycode) {
+    char c = keymap_typed(h->layout, modifier & ~(MOD_LCTRL | MOD_LALT), keycode);
+
+    if (modifier & MOD_LCTRL) {
+        bool ctrl_shift_u = (modifier & MOD_LSHIFT) && tolower((unsigned char)c) == 'u';
+        if (h->method == MACRO_METHOD_LINUX && ctrl_shift_u && !h->entry) {
+            h->entry = true;
+            h->hex = 0;
+        } else {
+            h->bad = true;
+        }
+    } else if (modifier & MOD_LALT) {
+        if (h->method == MACRO_METHOD_WINDOWS && tolower((unsigned char)c) == 'x') host_alt_x(h);
+        else h->bad = true;
+    } else if (c == 0) {
+        h->bad = true;
+    } else if (h->entry) {
+        if (c == ' ') {
+            h->entry = false;
+            host_utf8(h, h->hex);
+        } else if (isxdigit((unsigned char)c) && h->hex < 0x110000) {
+            h->hex = h->hex * 16 + (uint32_t)(isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10);
+        } else {
+            h->bad = true;
+        }
+    } else if (h->dead) {
+        // lenny_gen only ever follows a dead key with Space
+        if (c == ' ') host_utf8(h, (unsigned char)h->dead);
+        else h->bad = true;
+        h->dead = 0;
+    } else if (strchr(keymaps[h->layout].dead[h->method], c)) {
+        h->dead = c;
+    } else {
+        host_utf8(h, (unsigned char)c);
+    }
+}
+
+static void host_init(host_t *h, plan_t const *p) {
+    memset(h, 0, sizeof(*h));
+    h->layout = p->layout;
+    h->method = p->method;
+}
+
+static void host_report(host_t *h, hid_report_t r) {
+    if (r.keycode != 0 && r.keycode != h->last.keycode) host_key(h, r.modifier, r.keycode);
+    h->last = r;
+}
+
+// Everything left down or half-typed at the end is a fault too
+static bool host_done(host_t const *h) {
+    return !h->bad && !h->entry && !h->dead && h->last.modifier == 0 && h->last.keycode == 0;
+}
+
+// Both the planned taps, each released before the next, and the report
+// table made from them must type the macro's text
+static bool plan_check(plan_t const *p, const char *text, const char *file, int lineno) {
+    static host_t plain, compacted;
+    static char const *const names[] = KEYMAP_NAMES;
+
+    host_init(&plain, p);
+    for (size_t i = 0; i < p->tap_count; i++) {
+        host_report(&plain, p->taps[i]);
+        host_report(&plain, (hid_report_t){ 0, 0 });
+    }
+    host_init(&compacted, p);
+    for (size_t i = 0; i < p->count; i++) host_report(&compacted, p->reports[i]);
+
+    host_t const *wrong = NULL;
+    char const *what = NULL;
+    if (!host_done(&plain) || strcmp(plain.text, text)) { wrong = &plain; what = "the taps"; }
+    else if (!host_done(&compacted) || strcmp(compacted.text, text)) { wrong = &compacted; what = "the reports"; }
+    if (!wrong) return true;
+
+    fprintf(stderr, "%s:%d: layout %s, %s method: %s type \"%s\"%s instead of \"%s\"\n",
+            file, lineno, names[p->layout], p->method == MACRO_METHOD_LINUX ? "Linux" : "Windows",
+            what, wrong->text, host_done(wrong) ? "" : " (not cleanly)", text);
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// Library image
+//--------------------------------------------------------------------+
+
+static uint8_t image[MAX_IMAGE];
+static size_t image_len = 0;
+
+static void put_u8(size_t at, uint8_t v)   { image[at] = v; }
+static void put_u16(size_t at, uint16_t v) { image[at] = (uint8_t)v; image[at + 1] = (uint8_t)(v >> 8); }
+static void put_u32(size_t at, uint32_t v) { put_u16(at, (uint16_t)v); put_u16(at + 2, (uint16_t)(v >> 16)); }
+
+static size_t entry_at(uint16_t id, uint8_t layout, macro_method_t method) {
+    size_t slot = ((size_t)id * layout_count + layout) * MACRO_METHOD_COUNT + method;
+    return sizeof(macro_lib_header_t) + slot * sizeof(macro_lib_entry_t);
+}
+
+static void append_table(uint16_t id, uint8_t layout, macro_method_t method, const plan_t *p) {
+    if (image_len + p->count * sizeof(hid_report_t) > MAX_IMAGE) {
+        fprintf(stderr, "lenny_gen: library larger than %d bytes\n", MAX_IMAGE);
+        exit(1);
+    }
+
+    size_t e = entry_at(id, layout, method);
+    put_u32(e + offsetof(macro_lib_entry_t, offset), (uint32_t)image_len);
+    put_u16(e + offsetof(macro_lib_entry_t, length), (uint16_t)p->count);
+    put_u8(e + offsetof(macro_lib_entry_t, method), (uint8_t)method);
+    put_u8(e + offsetof(macro_lib_entry_t, flags), MACRO_FLAG_PRESENT);
+
+    for (size_t i = 0; i < p->count; i++) {
+        image[image_len++] = p->reports[i].modifier;
+        image[image_len++] = p->reports[i].keycode;
+    }
+}
+
+// Text index and the texts themselves, after the last report table
+static void append_texts(char **texts, uint16_t count) {
+    image_len = (image_len + 3) & ~(size_t)3;
+    size_t index = image_len;
+    image_len += (size_t)count * sizeof(macro_lib_entry_t);
+
+    for (uint16_t id = 0; id < count; id++) {
+        size_t len = strlen(texts[id]);
+        if (image_len + len + 1 > MAX_IMAGE) {
+            fprintf(stderr, "lenny_gen: library larger than %d bytes\n", MAX_IMAGE);
+            exit(1);
+        }
+
+        size_t e = index + (size_t)id * sizeof(macro_lib_entry_t);
+        put_u32(e + offsetof(macro_lib_entry_t, offset), (uint32_t)image_len);
+        put_u16(e + offsetof(macro_lib_entry_t, length), (uint16_t)len);
+        put_u8(e + offsetof(macro_lib_entry_t, method), MACRO_METHOD_COUNT);
+        put_u8(e + offsetof(macro_lib_entry_t, flags), MACRO_FLAG_PRESENT);
+
+        memcpy(&image[image_len], texts[id], len + 1);
+        image_len += len + 1;
+    }
+    put_u32(offsetof(macro_lib_header_t, text_offset), (uint32_t)index);
+}
+
+static void write_image(FILE *c, uint16_t count) {
+    put_u32(offsetof(macro_lib_header_t, magic), MACRO_LIB_MAGIC);
+    put_u16(offsetof(macro_lib_header_t, version), MACRO_LIB_VERSION);
+    put_u16(offsetof(macro_lib_header_t, count), count);
+    put_u32(offsetof(macro_lib_header_t, size), (uint32_t)image_len);
+    put_u8(offsetof(macro_lib_header_t, layout_count), layout_count);
+    for (uint8_t i = 0; i < MACRO_LIB_MAX_LAYOUTS; i++) {
+        put_u8(offsetof(macro_lib_header_t, layouts) + i, i < layout_count ? (uint8_t)layouts[i] : 0xFF);
+    }
+
+    // Own flash sectors, so the image can be found and replaced as a unit
+    fprintf(c, "__attribute__((section(\".rodata.lenny_library\"), aligned(4096)))\n");
+    fprintf(c, "const uint8_t lenny_library[%zu] = {", image_len);
+    for (size_t i = 0; i < image_len; i++) {
+        if (i % 16 == 0) fprintf(c, "\n   ");
+        fprintf(c, " 0x%02X,", image[i]);
+    }
+    fprintf(c, "\n};\n");
+}
+
+//--------------------------------------------------------------------+
+// Output
+//--------------------------------------------------------------------+
+
+static void write_id(FILE *h, const char *name, uint16_t id, const char *text) {
+    char upper[64];
+    size_t i;
+    for (i = 0; name[i] && i < sizeof(upper) - 1; i++) {
+        upper[i] = (char)toupper((unsigned char)name[i]);
+    }
+    upper[i] = 0;
+    fprintf(h, "#define MACRO_ID_%s %u  // %s\n", upper, (unsigned)id, text);
+}
+
+static bool valid_name(const char *name) {
+    if (!*name || isdigit((unsigned char)*name)) return false;
+    for (; *name; name++) {
+        if (!isalnum((unsigned char)*name) && *name != '_') return false;
+    }
+    return strlen(name) < 64;
+}
+
+// Compile one macro for every layout and input method into the image
+static bool compile_macro(const char *file, int lineno, uint16_t id, const char *text) {
+    static plan_t plan;
+
+    for (uint8_t l = 0; l < layout_count; l++)
+    for (macro_method_t m = 0; m < MACRO_METHOD_COUNT; m++) {
+        plan.count = 0;
+        plan.tap_count = 0;
+        plan.layout = layouts[l];
+        plan.method = m;
+        key_stream_init(&plan.stream);
+
+        const unsigned char *s = (const unsigned char *)text;
+        while (*s) {
+            uint32_t cp;
+            int len = utf8_decode(s, &cp);
+            if (len == 0) {
+                fprintf(stderr, "%s:%d: malformed UTF-8\n", file, lineno);
+                return false;
+            }
+            if (!plan_codepoint(&plan, cp)) {
+                fprintf(stderr, "%s:%d: no key for character 0x%02X\n", file, lineno, (unsigned)cp);
+                return false;
+            }
+            s += len;
+        }
+        plan_end(&plan);
+        if (!plan_check(&plan, text, file, lineno)) return false;
+        append_table(id, l, m, &plan);
+    }
+    return true;
+}
+
+// Parse -l us,de,...
+static bool parse_layouts(char *list) {
+    static char const *const names[] = KEYMAP_NAMES;
+    layout_count = 0;
+    for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        int found = -1;
+        for (int i = 0; i < KEYMAP_COUNT; i++) {
+            if (!strcmp(name, names[i])) found = i;
+        }
+        if (found < 0 || layout_count >= MACRO_LIB_MAX_LAYOUTS) {
+            fprintf(stderr, "lenny_gen: bad layout '%s' (us, de, fr; at most %d)\n", name, MACRO_LIB_MAX_LAYOUTS);
+            return false;
+        }
+        layouts[layout_count++] = (keymap_layout_t)found;
+    }
+    return layout_count > 0;
+}
+
+// Every table must round-trip before anything is compiled through it
+static bool check_layouts(void) {
+    static char const *const names[] = KEYMAP_NAMES;
+    for (int i = 0; i < KEYMAP_COUNT; i++) {
+        int c = keymap_verify((keymap_layout_t)i);
+        if (c >= 0) {
+            fprintf(stderr, "lenny_gen: layout %s: character 0x%02X has no key of its own, "
+                    "or that key types something else\n", names[i], c);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 5 && !strcmp(argv[1], "-l")) {
+        if (!parse_layouts(argv[2])) return 1;
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 3) {
+        fprintf(stderr, "usage: lenny_gen [-l <layout>[,<layout>...]] <macros.txt> <output-basename>\n");
+        return 1;
+    }
+    if (!check_layouts()) return 1;
+
+    FILE *in = fopen(argv[1], "r");
+    if (!in) { perror(argv[1]); return 1; }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.c", argv[2]);
+    FILE *c = fopen(path, "w");
+    if (!c) { perror(path); return 1; }
+    snprintf(path, sizeof(path), "%s.h", argv[2]);
+    FILE *h = fopen(path, "w");
+    if (!h) { perror(path); return 1; }
+
+    const char *base = strrchr(argv[2], '/');
+    base = base ? base + 1 : argv[2];
+
+    // Count the macros first - the report data starts after the index
+    char line[1024];
+    uint16_t count = 0;
+    while (fgets(line, sizeof(line), in)) {
+        if (line[0] != '#' && line[0] != '\n' && line[0] != '\r') count++;
+    }
+    if (count > MAX_MACROS) {
+        fprintf(stderr, "%s: more than %d macros\n", argv[1], MAX_MACROS);
+        return 1;
+    }
+    rewind(in);
+    image_len = entry_at(count, 0, 0);
+
+    fprintf(h, "// Generated by lenny_gen from macros.txt - do not edit\n\n");
+    fprintf(h, "#ifndef LENNY_MACROS_H\n#define LENNY_MACROS_H\n\n#include <stdint.h>\n\n");
+    fprintf(c, "// Generated by lenny_gen from macros.txt - do not edit\n\n");
+    fprintf(c, "#include \"%s.h\"\n\n", base);
+
+    int lineno = 0;
+    uint16_t id = 0;
+    static char *texts[MAX_MACROS];
+
+    while (fgets(line, sizeof(line), in)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '#' || line[0] == 0) continue;
+
+        char *tab = strchr(line, '\t');
+        if (!tab) {
+            fprintf(stderr, "%s:%d: expected <name><TAB><text>\n", argv[1], lineno);
+            return 1;
+        }
+        *tab = 0;
+        const char *name = line;
+        const char *text = tab + 1;
+        if (!valid_name(name)) {
+            fprintf(stderr, "%s:%d: '%s' is not a valid C identifier\n", argv[1], lineno, name);
+            return 1;
+        }
+
+        if (!compile_macro(argv[1], lineno, id, text)) return 1;
+        write_id(h, name, id, text);
+        texts[id++] = strdup(text);
+    }
+
+    append_texts(texts, count);
+    write_image(c, count);
+
+    snprintf(path, sizeof(path), "%s.bin", argv[2]);
+    FILE *bin = fopen(path, "wb");
+    if (!bin || fwrite(image, 1, image_len, bin) != image_len) { perror(path); return 1; }
+    fclose(bin);
+
+    fprintf(h, "\n#define MACRO_COUNT %u\n\n", (unsigned)count);
+    fprintf(h, "// Library image, see macro_library.h\n");
+    fprintf(h, "extern const uint8_t lenny_library[%zu];\n\n", image_len);
+    fprintf(h, "#endif\n");
+    fclose(in);
+    fclose(c);
+    fclose(h);
+    return 0;
+}
@@ -0,0 +1,103 @@
+// lenny_stats - reads the perf counters feature report from a running device
+//
+// Usage: lenny_stats </dev/hidrawN> [interval_s]
+// Prints the counters once, or every interval_s seconds with per-interval
+// rates (see perf.h for the fields). Linux only: uses HIDIOCGFEATURE, so no
+// driver beyond hidraw and no CDC interface are needed.
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/hidraw.h>
+#include "perf.h"
+
+static int read_report(int fd, perf_report_t *r) {
+    // Byte 0 is the report ID - 0, the keyboard interface uses none
+    unsigned char buf[1 + sizeof(perf_report_t)] = {0};
+    int n = ioctl(fd, HIDIOCGFEATURE(sizeof(buf)), buf);
+    if (n < 0) {
+        perror("HIDIOCGFEATURE");
+        return -1;
+    }
+
+    // The kernel keeps the report ID byte in front and counts it
+    unsigned char const *data = buf + 1;
+    size_t len = n > 0 ? (size_t)n - 1 : 0;
+    if (len < 2 || data[0] != PERF_REPORT_VERSION) {
+        fprintf(stderr, "unexpected counters report (%zu bytes, version %u)\n", len, len ? data[0] : 0);
+        return -1;
+    }
+
+    // Older firmware may send a shorter block; missing fields read as zero
+    memset(r, 0, sizeof(*r));
+    memcpy(r, data, len < sizeof(*r) ? len : sizeof(*r));
+    return 0;
+}
+
+static void print_report(perf_report_t const *r, perf_report_t const *prev) {
+    printf("uptime      %lu.%03lu s\n", (unsigned long)(r->uptime_ms / 1000), (unsigned long)(r->uptime_ms % 1000));
+
+    printf("loop        max %u us, busy time histogram:", r->loop_max_us);
+    for (int b = 0; b < PERF_LOOP_BUCKETS; b++) {
+        uint32_t n = r->loop_hist[b] - (prev ? prev->loop_hist[b] : 0);
+        if (b < PERF_LOOP_BUCKETS - 1) printf(" <%u:%u", 1u << b, n);
+        else printf(" >=%u:%u", 1u << (b - 1), n);
+    }
+    printf("\n");
+
+    uint32_t calls = r->task_calls - (prev ? prev->task_calls : 0);
+    uint32_t total = r->task_total_us - (prev ? prev->task_total_us : 0);
+    printf("tud_task    %u calls, avg %.2f us, max %u us\n",
+           calls, calls ? (double)total / calls : 0.0, r->task_max_us);
+    // Older firmware has no service interval
+    if (r->length >= offsetof(perf_report_t, task_interval_max_us) + sizeof(r->task_interval_max_us)) {
+        printf("            at most %u us between calls\n", r->task_interval_max_us);
+    }
+
+    printf("reports     %u sent, %u retried, %u dropped\n",
+           r->reports_sent, r->reports_retried, r->reports_dropped);
+    printf("debounce    %u edges, %u rejected\n", r->debounce_edges, r->debounce_rejects);
+    printf("sequences   %u, last %u us, max %u us\n",
+           r->sequences, r->sequence_last_us, r->sequence_max_us);
+
+    if (r->length >= offsetof(perf_report_t, reports_discarded) + sizeof(r->reports_discarded)) {
+        uint32_t faces = r->burst_faces - (prev ? prev->burst_faces : 0);
+        uint32_t us = r->burst_us - (prev ? prev->burst_us : 0);
+        printf("bursts      %u faces, %.1f faces/s; last %u faces, %.1f faces/s\n",
+               faces, us ? faces * 1e6 / us : 0.0,
+               r->burst_last_faces, r->burst_last_us ? r->burst_last_faces * 1e6 / r->burst_last_us : 0.0);
+        printf("dropped     %u reports discarded when the host went away\n", r->reports_discarded);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s </dev/hidrawN> [interval_s]\n", argv[0]);
+        return 1;
+    }
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    perf_report_t r, prev;
+    if (read_report(fd, &r) < 0) return 1;
+    print_report(&r, NULL);
+
+    int interval = argc == 3 ? atoi(argv[2]) : 0;
+    while (interval > 0) {
+        prev = r;
+        sleep((unsigned)interval);
+        if (read_report(fd, &r) < 0) return 1;
+        printf("\n");
+        print_report(&r, &prev);
+    }
+
+    close(fd);
+    return 0;
+}
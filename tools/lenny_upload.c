@@ -0,0 +1,160 @@
+// lenny_upload - replaces the macro library of a running device
+//
+// Usage: lenny_upload </dev/hidrawN> [library.bin]
+// Sends a library image (lenny_gen writes one next to the generated source,
+// as <name>.bin) over the upload interface, the device's second HID
+// interface, and prints the transfer rate. Without a file, prints which
+// library is active. See macro_upload.h for the protocol. Linux only.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include "macro_upload.h"
+
+#define REPLY_TIMEOUT_MS  10000  // begin erases up to a whole slot first
+
+static char const *const status_names[] = {
+    "ok", "busy typing", "too big", "not started", "out of order",
+    "short", "bad CRC", "bad image", "bad command",
+};
+
+typedef struct {
+    uint8_t cmd, status;
+    uint32_t received, generation;
+    uint16_t count;
+    int slot;
+} reply_t;
+
+static uint32_t crc32(uint8_t const *p, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int send_report(int fd, uint8_t const *report) {
+    // Byte 0 is the report ID - 0, the interface uses none
+    uint8_t buf[1 + MACRO_UPLOAD_REPORT_SIZE] = {0};
+    memcpy(buf + 1, report, MACRO_UPLOAD_REPORT_SIZE);
+    if (write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+        perror("write");
+        return -1;
+    }
+    return 0;
+}
+
+// Wait for the reply to cmd. A refused data report answers first with 'D'.
+static int read_reply(int fd, uint8_t cmd, reply_t *r) {
+    struct pollfd p = { .fd = fd, .events = POLLIN };
+    uint8_t d[MACRO_UPLOAD_REPORT_SIZE];
+    while (true) {
+        if (poll(&p, 1, REPLY_TIMEOUT_MS) <= 0) {
+            fprintf(stderr, "no reply to '%c'\n", cmd);
+            return -1;
+        }
+        ssize_t n = read(fd, d, sizeof(d));
+        if (n < 13) {
+            perror("read");
+            return -1;
+        }
+        r->cmd = d[0];
+        r->status = d[1];
+        r->received = d[2] | (uint32_t)d[3] << 8 | (uint32_t)d[4] << 16 | (uint32_t)d[5] << 24;
+        r->generation = d[6] | (uint32_t)d[7] << 8 | (uint32_t)d[8] << 16 | (uint32_t)d[9] << 24;
+        r->count = (uint16_t)(d[10] | d[11] << 8);
+        r->slot = (int8_t)d[12];
+        if (r->cmd == cmd || r->cmd == MACRO_UPLOAD_DATA) break;
+    }
+    if (r->status != UPLOAD_OK) {
+        fprintf(stderr, "'%c' refused: %s (%u bytes received)\n", r->cmd,
+                r->status < sizeof(status_names) / sizeof(status_names[0]) ? status_names[r->status] : "?",
+                r->received);
+        return -1;
+    }
+    return 0;
+}
+
+static void print_active(reply_t const *r) {
+    if (r->slot < 0) printf("active: built-in library, %u macros\n", r->count);
+    else printf("active: slot %d, generation %u, %u macros\n", r->slot, r->generation, r->count);
+}
+
+static int upload(int fd, uint8_t const *image, size_t len) {
+    uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { MACRO_UPLOAD_BEGIN };
+    reply_t reply;
+    uint32_t crc = crc32(image, len);
+    for (int i = 0; i < 4; i++) {
+        r[1 + i] = (uint8_t)(len >> (8 * i));
+        r[5 + i] = (uint8_t)(crc >> (8 * i));
+    }
+    if (send_report(fd, r) < 0 || read_reply(fd, MACRO_UPLOAD_BEGIN, &reply) < 0) return -1;
+
+    // Data reports are not acknowledged; the endpoint paces the writes
+    double start = now_s();
+    for (size_t off = 0; off < len; off += MACRO_UPLOAD_DATA_SIZE) {
+        size_t n = len - off < MACRO_UPLOAD_DATA_SIZE ? len - off : MACRO_UPLOAD_DATA_SIZE;
+        memset(r, 0, sizeof(r));
+        r[0] = MACRO_UPLOAD_DATA;
+        r[1] = (uint8_t)off;
+        r[2] = (uint8_t)(off >> 8);
+        r[3] = (uint8_t)(off >> 16);
+        memcpy(&r[4], image + off, n);
+        if (send_report(fd, r) < 0) return -1;
+    }
+
+    memset(r, 0, sizeof(r));
+    r[0] = MACRO_UPLOAD_COMMIT;
+    if (send_report(fd, r) < 0 || read_reply(fd, MACRO_UPLOAD_COMMIT, &reply) < 0) return -1;
+
+    double s = now_s() - start;
+    printf("%zu bytes in %.3f s (%.1f KB/s)\n", len, s, s > 0 ? len / s / 1000 : 0.0);
+    print_active(&reply);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s </dev/hidrawN> [library.bin]\n", argv[0]);
+        return 1;
+    }
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if (argc == 2) {
+        uint8_t r[MACRO_UPLOAD_REPORT_SIZE] = { MACRO_UPLOAD_STATUS };
+        reply_t reply;
+        if (send_report(fd, r) < 0 || read_reply(fd, MACRO_UPLOAD_STATUS, &reply) < 0) return 1;
+        print_active(&reply);
+        return 0;
+    }
+
+    FILE *f = fopen(argv[2], "rb");
+    if (!f) {
+        perror(argv[2]);
+        return 1;
+    }
+    static uint8_t image[MACRO_UPLOAD_MAX_IMAGE + 1];
+    size_t len = fread(image, 1, sizeof(image), f);
+    fclose(f);
+    if (len > MACRO_UPLOAD_MAX_IMAGE) {
+        fprintf(stderr, "%s: larger than %u bytes\n", argv[2], MACRO_UPLOAD_MAX_IMAGE);
+        return 1;
+    }
+    return upload(fd, image, len) < 0 ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// Trace hooks for LENNY_TRACE_LEVEL >= 1 - latency tracing and its log lines
+
+#include "trace.h"
+
+#if LENNY_TRACE_LEVEL >= 1
+
+#include "pico/stdlib.h"
+#include "hid_queue.h"
+#include "latency.h"
+#include "macro_library.h"
+
+static trigger_event_t last_press;
+static uint64_t queued_us = 0;
+
+void trace_press(trigger_event_t const *ev) {
+    last_press = *ev;
+}
+
+void trace_queued(uint16_t id, uint8_t method) {
+    queued_us = time_us_64();
+
+#if LENNY_TRACE_LEVEL >= 2
+    // Listing the keys only touches the log ring - typing has already started
+    hid_report_t const *reports;
+    uint16_t len;
+    if (!macro_library_get(id, (macro_method_t)method, &reports, &len)) return;
+    TRACE_LOG("\r\n=== TYPING MACRO %u (method %u) ===\r\n", id, method);
+    for (uint16_t i = 0; i < len; i++) {
+        TRACE_LOG("  KEY: mod=0x%02X key=0x%02X\r\n", reports[i].modifier, reports[i].keycode);
+    }
+    TRACE_LOG("=== QUEUED %u REPORTS FROM FLASH @%p ===\r\n\r\n", len, (void const *)reports);
+#else
+    (void)id; (void)method;
+#endif
+}
+
+void trace_sequence_done(void) {
+    TRACE_LOG("SEQUENCE: %u reports in %lu us (%lu retries total)\r\n",
+              hid_queue_sequence_len(), hid_queue_sequence_us(), hid_queue_retries());
+    TRACE_LOG("PACING: gap=%lu us host_accept=%lu us\r\n",
+              hid_queue_gap_us(), hid_queue_host_accept_us());
+
+    latency_trace_t trace = {
+        .edge_us      = last_press.first_edge_us,
+        .confirm_us   = last_press.confirm_us,
+        .queued_us    = queued_us,
+        .first_ack_us = hid_queue_first_ack_time(),
+        .last_ack_us  = hid_queue_last_ack_time(),
+    };
+    if (latency_record(&trace)) {
+        TRACE_LOG("LATENCY: edge->confirm=%lu ->queued=%lu ->1st ack=%lu ->last ack=%lu us\r\n",
+                  (uint32_t)(trace.confirm_us - trace.edge_us),
+                  (uint32_t)(trace.queued_us - trace.confirm_us),
+                  (uint32_t)(trace.first_ack_us - trace.queued_us),
+                  (uint32_t)(trace.last_ack_us - trace.first_ack_us));
+    }
+}
+
+void trace_latency_summary(void) {
+    uint32_t n = latency_count();
+    TRACE_LOG("LATENCY SUMMARY: %lu triggers (last %lu used)\r\n",
+              n, n < LATENCY_WINDOW ? n : (uint32_t)LATENCY_WINDOW);
+    TRACE_LOG("  stage               min      avg      p99      max (us)\r\n");
+    for (latency_stage_t s = 0; s < LAT_STAGE_COUNT; s++) {
+        latency_stats_t st;
+        if (!latency_stats(s, &st)) break;
+        TRACE_LOG("  %-16s %8lu %8lu %8lu %8lu\r\n",
+                  latency_stage_name(s), st.min_us, st.avg_us, st.p99_us, st.max_us);
+    }
+    (void)n;
+}
+
+#endif
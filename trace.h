@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "trigger.h"
+
+// Compile-time instrumentation levels for the shared firmware core
+//
+// LENNY_TRACE_LEVEL is set per CMake target:
+//   0 - production: every hook below expands to nothing and its arguments
+//       are never evaluated, so the hot path is exactly the untraced one
+//   1 - latency tracing: every trigger is timed into latency.c
+//   2 - level 1 plus the deferred CDC log (dbg_log.c)
+//
+// The HID perf counters (perf.h) are not a trace level - production has
+// them too.
+
+#ifndef LENNY_TRACE_LEVEL
+#define LENNY_TRACE_LEVEL 0
+#endif
+
+#if LENNY_TRACE_LEVEL >= 1
+void trace_press(trigger_event_t const *ev);      // a trigger was accepted
+void trace_queued(uint16_t id, uint8_t method);   // its macro went into hid_queue
+void trace_sequence_done(void);                   // ... and drained
+void trace_latency_summary(void);                 // log min/avg/p99 per stage
+#define TRACE_PRESS(ev)             trace_press(ev)
+#define TRACE_QUEUED(id, method)    trace_queued(id, method)
+#define TRACE_SEQUENCE_DONE()       trace_sequence_done()
+#else
+#define TRACE_PRESS(ev)             ((void)0)
+#define TRACE_QUEUED(id, method)    ((void)0)
+#define TRACE_SEQUENCE_DONE()       ((void)0)
+#endif
+
+#if LENNY_TRACE_LEVEL >= 2
+#include "dbg_log.h"
+#define TRACE_LOG(...)              dbg_log(__VA_ARGS__)
+// Send pending log output; true while some is still waiting for the FIFO
+#define TRACE_FLUSH()               (dbg_log_drain(), dbg_log_pending())
+#else
+#define TRACE_LOG(...)              ((void)0)
+#define TRACE_FLUSH()               false
+#endif
+
+#endif
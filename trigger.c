@@ -0,0 +1,124 @@
+// Trigger capture - clean edges from the PIO filter, timestamped into a ring
+
+#include "trigger.h"
+#include "trigger_filter.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#define EVENT_RING_SIZE 16   // power of two
+
+#define RAW_EDGES (GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE)
+
+typedef struct {
+    uint8_t pin;
+    volatile bool pressed;    // debounced; read by the other core
+    uint64_t first_edge_us;   // first raw edge of the current burst, 0 if none
+    uint64_t last_raw_us;     // latest raw edge
+} pin_state_t;
+
+// Debounced events: written by the PIO interrupt, read by the main loop
+static trigger_event_t event_ring[EVENT_RING_SIZE];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_tail = 0;
+
+static pin_state_t pin_state[TRIGGER_MAX_PINS];
+static uint8_t pin_count = 0;
+static uint32_t stable_window_us = 0;
+
+static volatile uint32_t edges = 0;
+static volatile uint32_t raw_edges = 0;
+
+// GPIO interrupt: every raw edge. A burst starts at the first edge after a
+// quiet gap longer than any bounce.
+static void on_raw_edge(uint gpio, uint32_t events) {
+    (void)events;
+    uint64_t now = time_us_64();
+    raw_edges++;
+    for (uint8_t i = 0; i < pin_count; i++) {
+        pin_state_t *p = &pin_state[i];
+        if (p->pin != gpio) continue;
+        if (p->first_edge_us == 0 || now - p->last_raw_us > TRIGGER_MAX_BOUNCE_US) p->first_edge_us = now;
+        p->last_raw_us = now;
+    }
+}
+
+// PIO interrupt: the filter only reports a level once it has held for the
+// whole window, so the edge that started it is exactly one window earlier
+static void on_filtered_edge(uint8_t pin, bool pressed) {
+    uint64_t now = time_us_64();
+    edges++;
+
+    uint64_t settled = now - stable_window_us;
+    uint64_t first_edge = settled;
+    for (uint8_t i = 0; i < pin_count; i++) {
+        if (pin_state[i].pin != pin) continue;
+        pin_state[i].pressed = pressed;
+
+        uint64_t raw = pin_state[i].first_edge_us;
+        if (raw != 0 && raw <= settled) first_edge = raw;
+        pin_state[i].first_edge_us = 0;
+    }
+
+    uint8_t next = (event_head + 1) & (EVENT_RING_SIZE - 1);
+    if (next == event_tail) return;  // main loop is not keeping up - drop
+
+    trigger_event_t *ev = &event_ring[event_head];
+    ev->pin = pin;
+    ev->pressed = pressed;
+    ev->first_edge_us = first_edge;
+    ev->edge_us = settled;
+    ev->confirm_us = now;
+    __mem_fence_release();
+    event_head = next;
+}
+
+void trigger_init(uint8_t const *pins, uint8_t count, uint32_t stable_us) {
+    if (count > TRIGGER_MAX_PINS) count = TRIGGER_MAX_PINS;
+    pin_count = count;
+    stable_window_us = stable_us;
+
+    for (uint8_t i = 0; i < count; i++) {
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_IN);
+        gpio_pull_up(pins[i]);
+    }
+    // Let the pull-ups settle before the filters take their initial level
+    sleep_us(10);
+
+    trigger_filter_set_callback(on_filtered_edge);
+    for (uint8_t i = 0; i < count; i++) {
+        pin_state[i].pin = pins[i];
+        pin_state[i].pressed = !gpio_get(pins[i]);
+        pin_state[i].first_edge_us = 0;
+        pin_state[i].last_raw_us = 0;
+        trigger_filter_add_pin(pins[i], stable_us);
+        gpio_set_irq_enabled_with_callback(pins[i], RAW_EDGES, true, on_raw_edge);
+    }
+}
+
+bool trigger_pop(trigger_event_t *ev) {
+    if (event_tail == event_head) return false;
+    __mem_fence_acquire();
+    *ev = event_ring[event_tail];
+    event_tail = (event_tail + 1) & (EVENT_RING_SIZE - 1);
+    return true;
+}
+
+bool trigger_is_pressed(uint8_t pin) {
+    for (uint8_t i = 0; i < pin_count; i++) {
+        if (pin_state[i].pin == pin) return pin_state[i].pressed;
+    }
+    return false;
+}
+
+uint32_t trigger_reject_count(void) {
+    // One raw edge started each accepted level; the rest were swallowed
+    uint32_t accepted = edges;
+    uint32_t raw = raw_edges;
+    return raw > accepted ? raw - accepted : 0;
+}
+
+uint32_t trigger_edge_count(void) {
+    return edges;
+}
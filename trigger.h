@@ -0,0 +1,47 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Interrupt-driven trigger inputs.
+//
+// Sampling and debouncing run in PIO (trigger_filter.pio), which only
+// reports a level once it has held for the whole stability window. The PIO
+// interrupt timestamps each clean edge into a lock-free ring of
+// press/release events for the main loop. Nothing here needs polling.
+//
+// A GPIO edge interrupt also sees every raw edge, to timestamp the first
+// edge of each bounce burst (for latency measurement) and to count the
+// edges the filter swallowed (debounce rejects).
+
+#define TRIGGER_MAX_PINS 4
+
+// Raw edges further apart than this belong to different bounce bursts
+#define TRIGGER_MAX_BOUNCE_US 20000
+
+typedef struct {
+    uint8_t pin;
+    bool pressed;         // pin shorted to ground
+    uint64_t first_edge_us;  // first raw edge of the bounce burst
+    uint64_t edge_us;        // start of the level that settled
+    uint64_t confirm_us;     // when the stability window ran out
+} trigger_event_t;
+
+// Configure the pins as pulled-up inputs and start capturing
+void trigger_init(uint8_t const *pins, uint8_t count, uint32_t stable_us);
+
+// Pop the next debounced event. Returns false if there is none.
+bool trigger_pop(trigger_event_t *ev);
+
+// Current debounced state of a pin (no GPIO access). Safe to call from
+// either core.
+bool trigger_is_pressed(uint8_t pin);
+
+// Debounced edges seen since boot
+uint32_t trigger_edge_count(void);
+
+// Raw edges the filter rejected since boot (bounce and glitches)
+uint32_t trigger_reject_count(void);
+
+#endif
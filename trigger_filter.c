@@ -0,0 +1,62 @@
+// PIO trigger filter driver
+
+#include "trigger_filter.h"
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "trigger_filter.pio.h"
+
+#define TRIGGER_FILTER_PIO     pio0
+#define TRIGGER_FILTER_PIO_IRQ PIO0_IRQ_0
+
+static trigger_filter_callback_t callback = NULL;
+static int program_offset = -1;
+static uint8_t sm_pin[4];
+static uint8_t sm_mask = 0;
+
+static void on_pio_irq(void) {
+    PIO pio = TRIGGER_FILTER_PIO;
+    for (uint sm = 0; sm < 4; sm++) {
+        if (!(sm_mask & (1u << sm))) continue;
+        while (!pio_sm_is_rx_fifo_empty(pio, sm)) {
+            bool pressed = (pio_sm_get(pio, sm) == 0);
+            if (callback) callback(sm_pin[sm], pressed);
+        }
+    }
+}
+
+void trigger_filter_set_callback(trigger_filter_callback_t cb) {
+    callback = cb;
+}
+
+bool trigger_filter_add_pin(uint8_t pin, uint32_t stable_us) {
+    PIO pio = TRIGGER_FILTER_PIO;
+
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) return false;
+
+    if (program_offset < 0) {
+        program_offset = pio_add_program(pio, &trigger_filter_program);
+        irq_set_exclusive_handler(TRIGGER_FILTER_PIO_IRQ, on_pio_irq);
+        irq_set_enabled(TRIGGER_FILTER_PIO_IRQ, true);
+    }
+
+    uint32_t samples = (uint32_t)(((uint64_t)stable_us * TRIGGER_FILTER_SAMPLE_HZ) / 1000000);
+    if (samples < 1) samples = 1;
+
+    sm_pin[sm] = pin;
+    sm_mask |= (uint8_t)(1u << sm);
+    trigger_filter_program_init(pio, (uint)sm, (uint)program_offset, pin,
+                                TRIGGER_FILTER_SAMPLE_HZ, samples);
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_sm0_rx_fifo_not_empty + sm), true);
+    return true;
+}
+
+void trigger_filter_clock_changed(void) {
+    PIO pio = TRIGGER_FILTER_PIO;
+    float div = (float)clock_get_hz(clk_sys) / (2.0f * (float)TRIGGER_FILTER_SAMPLE_HZ);
+    for (uint sm = 0; sm < 4; sm++) {
+        if (sm_mask & (1u << sm)) pio_sm_set_clkdiv(pio, sm, div);
+    }
+}
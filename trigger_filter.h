@@ -0,0 +1,28 @@
+#ifndef TRIGGER_FILTER_H
+#define TRIGGER_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// PIO glitch filter for trigger inputs (trigger_filter.pio)
+//
+// One state machine per pin samples it at TRIGGER_FILTER_SAMPLE_HZ and only
+// reports a level once it has held for the whole stability window. Clean
+// edges arrive through the RX FIFO interrupt; the CPU never samples.
+
+#define TRIGGER_FILTER_SAMPLE_HZ 10000
+
+// Called from the PIO interrupt for every accepted level change
+typedef void (*trigger_filter_callback_t)(uint8_t pin, bool pressed);
+
+void trigger_filter_set_callback(trigger_filter_callback_t cb);
+
+// Start filtering a pin. The pin must already be an input with its pull-up
+// enabled. Returns false if no state machine is free.
+bool trigger_filter_add_pin(uint8_t pin, uint32_t stable_us);
+
+// Re-derive the sample clock after clk_sys has changed, so the stability
+// window stays the same length in microseconds
+void trigger_filter_clock_changed(void);
+
+#endif
@@ -14,7 +14,7 @@
 
 // Enable CDC + HID for debug
 #define CFG_TUD_CDC           1
-#define CFG_TUD_HID           1
+#define CFG_TUD_HID           2   // keyboard + macro upload (vendor)
 #define CFG_TUD_MSC           0
 #define CFG_TUD_MIDI          0
 #define CFG_TUD_VENDOR        0
@@ -23,7 +23,7 @@
 #define CFG_TUD_CDC_RX_BUFSIZE 256
 #define CFG_TUD_CDC_TX_BUFSIZE 256
 
-// HID buffer
-#define CFG_TUD_HID_EP_BUFSIZE 16
+// HID buffer - also bounds GET_REPORT replies, so it must fit perf_report_t
+#define CFG_TUD_HID_EP_BUFSIZE 128
 
 #endif
@@ -12,13 +12,24 @@
 #define CFG_TUD_ENABLED       1
 #define CFG_TUD_ENDPOINT0_SIZE 64
 
-// HID only for production
-#define CFG_TUD_HID           1
-#define CFG_TUD_CDC           0
+// HID only for production, plus the companion daemon's CDC port when
+// lenny_keyboard is built with -DLENNY_COMPANION=ON
+#ifndef LENNY_COMPANION
+#define LENNY_COMPANION       0
+#endif
+#define CFG_TUD_HID           2   // keyboard + macro upload (vendor)
+#define CFG_TUD_CDC           LENNY_COMPANION
 #define CFG_TUD_MSC           0
 #define CFG_TUD_MIDI          0
 #define CFG_TUD_VENDOR        0
 
-#define CFG_TUD_HID_EP_BUFSIZE 16
+// HID buffer - also bounds GET_REPORT replies, so it must fit perf_report_t
+#define CFG_TUD_HID_EP_BUFSIZE 128
+
+// CDC buffer sizes - the TX FIFO must hold a ping and a text frame at once
+#if LENNY_COMPANION
+#define CFG_TUD_CDC_RX_BUFSIZE 64
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+#endif
 
 #endif